@@ -0,0 +1,190 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Times LzwBitReader against the per-code extractor it replaced,
+ * reading the same code streams with both of them.
+ *
+ * The old extractor assembled codes MSB-first, so it yields different values
+ * than the (correct) LSB-first reader: only the time is compared, the codes
+ * read by the new reader are checked against the generated ones.
+ */
+
+#include "../src/LzwDecoder.h"
+#include "../src/Logger.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define BENCH_CODE_COUNT    (1 << 20)
+#define BENCH_ROUND_COUNT   20
+// GIF encoders usually write full sub-blocks
+#define BENCH_SUB_BLOCK_SIZE 255
+
+struct CodeStream
+{
+    uint8_t codeSize{};
+    std::vector<uint16_t> codes;
+    // The codes packed LSB-first without sub-block size bytes, padded for the old extractor
+    std::vector<uint8_t> packed;
+    // The same bytes split into a chain of sub-blocks, as stored in a GIF file
+    std::vector<uint8_t> subBlocks;
+};
+
+static CodeStream makeCodeStream(uint8_t codeSize, std::mt19937* rng)
+{
+    CodeStream stream;
+    stream.codeSize = codeSize;
+    stream.codes.resize(BENCH_CODE_COUNT);
+    std::uniform_int_distribution<uint32_t> codeDist{0, (1u << codeSize) - 1};
+
+    uint64_t bitBuffer{};
+    uint32_t bitCount{};
+    for (uint16_t& code : stream.codes)
+    {
+        code = uint16_t(codeDist(*rng));
+        bitBuffer |= uint64_t(code) << bitCount;
+        bitCount += codeSize;
+        for (; bitCount >= 8; bitCount -= 8, bitBuffer >>= 8)
+            stream.packed.push_back(uint8_t(bitBuffer));
+    }
+    if (bitCount)
+        stream.packed.push_back(uint8_t(bitBuffer));
+
+    for (size_t offset{}; offset < stream.packed.size(); offset += BENCH_SUB_BLOCK_SIZE)
+    {
+        const size_t size{std::min(stream.packed.size() - offset, size_t(BENCH_SUB_BLOCK_SIZE))};
+        stream.subBlocks.push_back(uint8_t(size));
+        stream.subBlocks.insert(stream.subBlocks.end(), stream.packed.begin() + offset, stream.packed.begin() + offset + size);
+    }
+    stream.subBlocks.push_back(0);
+
+    // The old extractor always copies 3 bytes
+    stream.packed.resize(stream.packed.size() + 2);
+    return stream;
+}
+
+/*
+ * The code extractor of the old decoder, as it was.
+ */
+static uint16_t extractDataFromBuffer(uint32_t currentBitOffset, uint8_t codeSize, const std::vector<uint8_t>& inputBuffer)
+{
+    uint32_t output{};
+    const uint32_t startByteOffset{currentBitOffset / 8};
+    const uint8_t bitsToShift{uint8_t(24 - currentBitOffset % 8 - codeSize)};
+
+    {
+        uint8_t outputBuff[3]{};
+        std::memcpy(&outputBuff, inputBuffer.data() + startByteOffset, 3);
+        output =
+            (uint32_t)outputBuff[0] << 16 |
+            (uint32_t)outputBuff[1] <<  8 |
+            (uint32_t)outputBuff[2] <<  0;
+    }
+
+    output >>= bitsToShift;
+
+    uint16_t bitmask{};
+    for (int i{}; i < codeSize; ++i)
+        bitmask |= 1 << i;
+
+    output &= bitmask;
+    return uint16_t(output);
+}
+
+static uint64_t readWithOldExtractor(const CodeStream& stream)
+{
+    uint64_t sum{};
+    const size_t bitCount{(stream.packed.size() - 2) * 8};
+    for (uint32_t bitOffset{}; bitOffset + stream.codeSize <= bitCount; bitOffset += stream.codeSize)
+        sum += extractDataFromBuffer(bitOffset, stream.codeSize, stream.packed);
+    return sum;
+}
+
+static uint64_t readWithBitReader(const CodeStream& stream)
+{
+    uint64_t sum{};
+    LzwBitReader reader{stream.subBlocks.data(), stream.subBlocks.size()};
+    uint16_t code{};
+    while (reader.read(stream.codeSize, &code))
+        sum += code;
+    return sum;
+}
+
+/*
+ * Returns the best time of `BENCH_ROUND_COUNT` rounds in nanoseconds per code.
+ */
+template <typename Func>
+static double timeReads(const CodeStream& stream, Func readFunc, uint64_t* sumOut)
+{
+    double bestNs{};
+    for (int roundI{}; roundI < BENCH_ROUND_COUNT; ++roundI)
+    {
+        const auto start{std::chrono::steady_clock::now()};
+        *sumOut += readFunc(stream);
+        const double ns{double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count())};
+        if (roundI == 0 || ns < bestNs)
+            bestNs = ns;
+    }
+    return bestNs / stream.codes.size();
+}
+
+int main()
+{
+    std::mt19937 rng{1234};
+    // Keeps the reads from being optimized out
+    uint64_t sum{};
+    int failureCount{};
+
+    for (uint8_t codeSize{3}; codeSize <= LZW_MAX_CODE_SIZE; ++codeSize)
+    {
+        const CodeStream stream{makeCodeStream(codeSize, &rng)};
+
+        LzwBitReader reader{stream.subBlocks.data(), stream.subBlocks.size()};
+        size_t codeI{};
+        uint16_t code{};
+        while (reader.read(codeSize, &code) && codeI < stream.codes.size() && code == stream.codes[codeI])
+            ++codeI;
+        if (codeI != stream.codes.size())
+        {
+            Logger::err << "Code " << codeI << " of the " << +codeSize << "-bit stream read incorrectly" << Logger::End;
+            ++failureCount;
+            continue;
+        }
+
+        const double oldNs{timeReads(stream, readWithOldExtractor, &sum)};
+        const double newNs{timeReads(stream, readWithBitReader, &sum)};
+        Logger::log << +codeSize << "-bit codes: old extractor " << oldNs << " ns/code, LzwBitReader "
+            << newNs << " ns/code, " << oldNs / newNs << "x" << Logger::End;
+    }
+
+    Logger::log << "Checksum: " << sum << Logger::End;
+    return failureCount ? 1 : 0;
+}
@@ -607,45 +607,12 @@ int BmpImage::_render8BitImage(
         uint8_t* pixelArray,
         uint32_t viewportWidth, uint32_t viewportHeight) const
 {
-   uint_fast32_t xPos{};
-   uint_fast32_t yPos{m_bitmapHeightPx - 1};
+    (void)viewportWidth;
 
-    for (uint_fast32_t i{}; yPos != (uint_fast32_t)-1; ++i)
+    for (uint32_t row{}; row < m_bitmapHeightPx && row < viewportHeight; ++row)
     {
-        if (xPos < viewportWidth && yPos < viewportHeight)
-        {
-            uint8_t paletteI{m_buffer[m_bitmapOffset + i]};
-            if (m_numOfPaletteColors && paletteI >= m_numOfPaletteColors)
-            {
-                Logger::err <<
-                    "Invalid color index while rendering 8-bit image: " << (int)paletteI <<
-                    ", palette only has " << m_numOfPaletteColors << " entries" << Logger::End;
-                return 1;
-            }
-
-            uint8_t colorR{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 2]};
-            uint8_t colorG{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 1]};
-            uint8_t colorB{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 0]};
-            Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
-        }
-
-        // If the last pixel of the line
-        if (xPos == m_bitmapWidthPx - 1)
-        {
-            /*
-             * Add padding to the offset:
-             * Every line needs to be padded to a multiple of 4 with additional bytes at the end.
-             */
-            if (m_bitmapWidthPx % 4)
-                i += 4 - m_bitmapWidthPx %  4;
-
-            xPos = 0;
-            --yPos;
-        }
-        else
-        {
-            ++xPos;
-        }
+        if (_renderRow(pixelArray + size_t(row) * m_bitmapWidthPx * 4, row))
+            return 1;
     }
 
     return 0;
@@ -728,36 +695,67 @@ int BmpImage::_render24BitImage(
         uint8_t* pixelArray,
         uint32_t viewportWidth, uint32_t viewportHeight) const
 {
-    uint_fast32_t xPos{};
-    uint_fast32_t yPos{m_bitmapHeightPx - 1};
+    (void)viewportWidth;
 
-    for (uint_fast32_t i{}; yPos != (uint_fast32_t)-1; i += 3)
+    for (uint32_t row{}; row < m_bitmapHeightPx && row < viewportHeight; ++row)
     {
-        if (xPos < viewportWidth && yPos < viewportHeight)
-        {
-            // BGR format!
-            uint8_t colorR{m_buffer[m_bitmapOffset + i + 2]};
-            uint8_t colorG{m_buffer[m_bitmapOffset + i + 1]};
-            uint8_t colorB{m_buffer[m_bitmapOffset + i + 0]};
+        if (_renderRow(pixelArray + size_t(row) * m_bitmapWidthPx * 4, row))
+            return 1;
+    }
 
-            Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
-        }
+    return 0;
+}
 
-        // If the last pixel of the line
-        if (xPos == m_bitmapWidthPx - 1)
+bool BmpImage::_getRowByteRange(uint32_t row, uint64_t* offsetOut, uint64_t* sizeOut) const
+{
+    if ((m_bitsPerPixel != 8 && m_bitsPerPixel != 24) || m_compMethod != CompressionMethod::BI_RGB)
+        return false;
+
+    // Every line is padded to a multiple of 4 bytes
+    const uint64_t rowSize{(uint64_t(m_bitmapWidthPx) * m_bitsPerPixel / 8 + 3) / 4 * 4};
+    *sizeOut = rowSize;
+    // The last row is the first one in the file
+    *offsetOut = m_bitmapOffset + (m_bitmapHeightPx - 1 - row) * rowSize;
+    return true;
+}
+
+int BmpImage::_renderRow(uint8_t* rowPixels, uint32_t row) const
+{
+    uint64_t offset{};
+    uint64_t rowSize{};
+    if (!_getRowByteRange(row, &offset, &rowSize))
+        return 1;
+    if (offset + uint64_t(m_bitmapWidthPx) * m_bitsPerPixel / 8 > m_fileSize) // Truncated file
+        return 0;
+
+    if (m_bitsPerPixel == 8)
+    {
+        for (uint32_t xPos{}; xPos < m_bitmapWidthPx; ++xPos)
         {
-            /*
-             * Add padding to the offset:
-             * Every line needs to be padded to a multiple of 4 with additional bytes at the end.
-             */
-            i += m_bitmapWidthPx % 4;
+            uint8_t paletteI{m_buffer[offset + xPos]};
+            if (m_numOfPaletteColors && paletteI >= m_numOfPaletteColors)
+            {
+                Logger::err <<
+                    "Invalid color index while rendering 8-bit image: " << (int)paletteI <<
+                    ", palette only has " << m_numOfPaletteColors << " entries" << Logger::End;
+                return 1;
+            }
 
-            xPos = 0;
-            --yPos;
+            uint8_t colorR{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 2]};
+            uint8_t colorG{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 1]};
+            uint8_t colorB{m_buffer[BMP_DIB_HEADER_OFFS + m_dibHeaderSize + paletteI * 4 + 0]};
+            Gfx::drawPointAt(rowPixels, m_bitmapWidthPx, xPos, 0, {colorR, colorG, colorB});
         }
-        else
+    }
+    else
+    {
+        for (uint32_t xPos{}; xPos < m_bitmapWidthPx; ++xPos, offset += 3)
         {
-            ++xPos;
+            // BGR format!
+            uint8_t colorR{m_buffer[offset + 2]};
+            uint8_t colorG{m_buffer[offset + 1]};
+            uint8_t colorB{m_buffer[offset + 0]};
+            Gfx::drawPointAt(rowPixels, m_bitmapWidthPx, xPos, 0, {colorR, colorG, colorB});
         }
     }
 
@@ -837,42 +835,56 @@ int BmpImage::_render32BitImage(
 
     return 0;
 }
-int BmpImage::render(
-        SDL_Texture* texture,
+int BmpImage::renderToPixelArray(
+        uint8_t* pixelArray,
         uint32_t viewportWidth, uint32_t viewportHeight) const
 {
-    if (!m_isInitialized)
-    {
-        Logger::err << "Cannot draw uninitialized image" << Logger::End;
-        return 1;
-    }
-
-    SDL_Rect lockRect{0, 0, (int)viewportWidth, (int)viewportHeight};
-    uint8_t* pixelArray{};
-    int pitch{};
-    if (SDL_LockTexture(texture, &lockRect, (void**)&pixelArray, &pitch))
-    {
-        Logger::err << "Failed to lock texture: " << SDL_GetError() << Logger::End;
-        return 1;
-    }
-
-    int renderStatus{};
     switch (m_bitsPerPixel)
     {
-    case  1: renderStatus =  _render1BitImage(pixelArray, viewportWidth, viewportHeight); break;
-    case  4: renderStatus =  _render4BitImage(pixelArray, viewportWidth, viewportHeight); break;
-    case  8: renderStatus =  _render8BitImage(pixelArray, viewportWidth, viewportHeight); break;
-    case 16: renderStatus = _render16BitImage(pixelArray, viewportWidth, viewportHeight); break;
-    case 24: renderStatus = _render24BitImage(pixelArray, viewportWidth, viewportHeight); break;
-    case 32: renderStatus = _render32BitImage(pixelArray, viewportWidth, viewportHeight); break;
+    case  1: return  _render1BitImage(pixelArray, viewportWidth, viewportHeight);
+    case  4: return  _render4BitImage(pixelArray, viewportWidth, viewportHeight);
+    case  8: return  _render8BitImage(pixelArray, viewportWidth, viewportHeight);
+    case 16: return _render16BitImage(pixelArray, viewportWidth, viewportHeight);
+    case 24: return _render24BitImage(pixelArray, viewportWidth, viewportHeight);
+    case 32: return _render32BitImage(pixelArray, viewportWidth, viewportHeight);
     default:
         Logger::err << "Unimplemented color depth" << Logger::End;
-        SDL_UnlockTexture(texture);
         return 1;
     }
+}
+
+std::shared_ptr<DecodedImage> BmpImage::decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const
+{
+    if (!m_isInitialized || m_bitsPerPixel != 24 || m_compMethod != CompressionMethod::BI_RGB)
+        return Image::decodeThumbnail(maxWidthPx, maxHeightPx);
+
+    uint32_t thumbWidth{};
+    uint32_t thumbHeight{};
+    _getThumbnailSize(maxWidthPx, maxHeightPx, &thumbWidth, &thumbHeight);
+    auto thumbnail{std::make_shared<DecodedImage>(thumbWidth, thumbHeight)};
+
+    // Every line is padded to a multiple of 4 bytes
+    const uint64_t rowSize{(uint64_t(m_bitmapWidthPx) * 3 + 3) / 4 * 4};
+    for (uint32_t dstY{}; dstY < thumbHeight; ++dstY)
+    {
+        // Sample the center of the area covered by the thumbnail pixel
+        const uint32_t srcY{uint32_t((uint64_t(dstY) * 2 + 1) * m_bitmapHeightPx / (thumbHeight * 2))};
+        // The bitmap is stored bottom-up
+        const uint64_t rowOffset{m_bitmapOffset + (m_bitmapHeightPx - 1 - srcY) * rowSize};
+        for (uint32_t dstX{}; dstX < thumbWidth; ++dstX)
+        {
+            const uint32_t srcX{uint32_t((uint64_t(dstX) * 2 + 1) * m_bitmapWidthPx / (thumbWidth * 2))};
+            const uint64_t offset{rowOffset + uint64_t(srcX) * 3};
+            if (offset + 3 > m_fileSize) // Truncated file
+                continue;
+
+            // BGR format!
+            Gfx::drawPointAt(thumbnail->getPixels(), thumbWidth, dstX, dstY,
+                    {m_buffer[offset + 2], m_buffer[offset + 1], m_buffer[offset + 0]});
+        }
+    }
 
-    SDL_UnlockTexture(texture);
-    return renderStatus;
+    return thumbnail;
 }
 
 BmpImage::~BmpImage()
@@ -97,10 +97,16 @@ private:
             uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const;
 
+    // Uncompressed 8-bit and 24-bit images are row-addressable
+    virtual bool _getRowByteRange(uint32_t row, uint64_t* offsetOut, uint64_t* sizeOut) const override;
+    virtual int _renderRow(uint8_t* rowPixels, uint32_t row) const override;
+
 public:
     virtual int open(const std::string& filepath) override;
-    virtual int render(
-            SDL_Texture* texture,
+    // Uncompressed 24-bit images are subsampled, only the used pixels are read
+    virtual std::shared_ptr<DecodedImage> decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const override;
+    virtual int renderToPixelArray(
+            uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const override;
 
     virtual ~BmpImage() override;
@@ -0,0 +1,159 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "DecodedImage.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+DecodedImage::DecodedImage(uint32_t widthPx, uint32_t heightPx)
+    : m_widthPx{widthPx}, m_heightPx{heightPx}, m_pixelBuffer(size_t(widthPx) * heightPx * 4)
+{
+    m_pixels = m_pixelBuffer.data();
+}
+
+DecodedImage::DecodedImage(
+        uint32_t widthPx, uint32_t heightPx,
+        void* mapping, size_t mappingSize, size_t pixelOffset)
+    : m_widthPx{widthPx}, m_heightPx{heightPx}, m_mapping{mapping}, m_mappingSize{mappingSize}
+{
+    m_pixels = (uint8_t*)m_mapping + pixelOffset;
+}
+
+DecodedImage::~DecodedImage()
+{
+    if (m_mapping)
+        munmap(m_mapping, m_mappingSize);
+}
+
+DecodedWideImage::DecodedWideImage(
+        uint32_t widthPx, uint32_t heightPx, uint32_t samplesPerPixel, uint16_t maxSampleVal)
+    : m_widthPx{widthPx}, m_heightPx{heightPx}, m_samplesPerPixel{samplesPerPixel}, m_maxSampleVal{maxSampleVal},
+    m_samples(size_t(widthPx) * heightPx * samplesPerPixel), m_decodedPixelCount{size_t(widthPx) * heightPx}
+{
+}
+
+void DecodedWideImage::buildLevelsTable(double windowCenter, double windowWidth, std::vector<uint8_t>* tableOut)
+{
+    tableOut->resize(65536);
+    const double windowStart{windowCenter - windowWidth / 2};
+    for (size_t i{}; i < tableOut->size(); ++i)
+    {
+        // Round to the nearest value
+        const double value{std::floor((i - windowStart) * 255 / windowWidth + 0.5)};
+        (*tableOut)[i] = uint8_t(std::clamp(value, 0.0, 255.0));
+    }
+}
+
+void DecodedWideImage::renderToPixelArray(const std::vector<uint8_t>& levelsTable, uint8_t* pixelArray) const
+{
+    std::vector<uint8_t> alphaTable;
+    buildLevelsTable(m_maxSampleVal / 2.0, m_maxSampleVal, &alphaTable);
+
+    const size_t pixelCount{m_decodedPixelCount};
+    std::memset(pixelArray + pixelCount * 4, 0, (size_t(m_widthPx) * m_heightPx - pixelCount) * 4);
+    const uint16_t* samples{m_samples.data()};
+    const uint8_t* levels{levelsTable.data()};
+    const uint8_t* alphas{alphaTable.data()};
+    switch (m_samplesPerPixel)
+    {
+    case 1:
+        for (size_t i{}; i < pixelCount; ++i)
+        {
+            const uint8_t gray{levels[samples[i]]};
+            pixelArray[i * 4 + 0] = gray;
+            pixelArray[i * 4 + 1] = gray;
+            pixelArray[i * 4 + 2] = gray;
+            pixelArray[i * 4 + 3] = 255;
+        }
+        break;
+
+    case 2:
+        for (size_t i{}; i < pixelCount; ++i)
+        {
+            const uint8_t gray{levels[samples[i * 2]]};
+            pixelArray[i * 4 + 0] = gray;
+            pixelArray[i * 4 + 1] = gray;
+            pixelArray[i * 4 + 2] = gray;
+            pixelArray[i * 4 + 3] = alphas[samples[i * 2 + 1]];
+        }
+        break;
+
+    case 3:
+        for (size_t i{}; i < pixelCount; ++i)
+        {
+            pixelArray[i * 4 + 0] = levels[samples[i * 3 + 0]];
+            pixelArray[i * 4 + 1] = levels[samples[i * 3 + 1]];
+            pixelArray[i * 4 + 2] = levels[samples[i * 3 + 2]];
+            pixelArray[i * 4 + 3] = 255;
+        }
+        break;
+
+    default:
+        for (size_t i{}; i < pixelCount; ++i)
+        {
+            pixelArray[i * 4 + 0] = levels[samples[i * 4 + 0]];
+            pixelArray[i * 4 + 1] = levels[samples[i * 4 + 1]];
+            pixelArray[i * 4 + 2] = levels[samples[i * 4 + 2]];
+            pixelArray[i * 4 + 3] = alphas[samples[i * 4 + 3]];
+        }
+        break;
+    }
+}
+
+DecodedImagePool::DecodedImagePool(size_t maxFreeCount)
+{
+    m_shared->maxFreeCount = maxFreeCount;
+}
+
+std::shared_ptr<DecodedImage> DecodedImagePool::get(uint32_t widthPx, uint32_t heightPx)
+{
+    std::unique_ptr<DecodedImage> surface;
+    {
+        std::lock_guard<std::mutex> lock{m_shared->mutex};
+        while (!surface && !m_shared->surfaces.empty())
+        {
+            std::unique_ptr<DecodedImage> candidate{std::move(m_shared->surfaces.back())};
+            m_shared->surfaces.pop_back();
+            // The surfaces of another size are freed
+            if (candidate->getWidthPx() == widthPx && candidate->getHeightPx() == heightPx)
+                surface = std::move(candidate);
+        }
+    }
+    if (!surface)
+        surface = std::make_unique<DecodedImage>(widthPx, heightPx);
+
+    return std::shared_ptr<DecodedImage>{surface.release(), [shared{m_shared}](DecodedImage* released){
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        if (shared->surfaces.size() < shared->maxFreeCount)
+            shared->surfaces.emplace_back(released);
+        else
+            delete released;
+    }};
+}
@@ -0,0 +1,165 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * A fully decoded image: an array of RGBA32 pixels.
+ *
+ * Decoded images are shared using `std::shared_ptr`s, so the cache,
+ * the texture uploader and the prefetchers can use them without copying.
+ *
+ * The pixels are either stored in an owned buffer or in a private
+ * (copy-on-write) memory mapping of a disk cache file.
+ */
+class DecodedImage final
+{
+private:
+    uint32_t m_widthPx{};
+    uint32_t m_heightPx{};
+    std::vector<uint8_t> m_pixelBuffer{};
+    // Points into `m_pixelBuffer` or `m_mapping`
+    uint8_t* m_pixels{};
+    void* m_mapping{};
+    size_t m_mappingSize{};
+
+public:
+    DecodedImage(uint32_t widthPx, uint32_t heightPx);
+
+    /*
+     * Creates an image using the pixels in a memory mapping.
+     * The image takes the ownership of the mapping.
+     */
+    DecodedImage(
+            uint32_t widthPx, uint32_t heightPx,
+            void* mapping, size_t mappingSize, size_t pixelOffset);
+
+    DecodedImage(const DecodedImage&) = delete;
+    DecodedImage& operator=(const DecodedImage&) = delete;
+
+    inline uint32_t getWidthPx() const { return m_widthPx; }
+    inline uint32_t getHeightPx() const { return m_heightPx; }
+    // Number of bytes in a row of pixels
+    inline int getPitch() const { return int(m_widthPx * 4); }
+    inline size_t getSizeInBytes() const { return size_t(m_widthPx) * m_heightPx * 4; }
+    inline bool isMapped() const { return m_mapping; }
+
+    inline uint8_t* getPixels() { return m_pixels; }
+    inline const uint8_t* getPixels() const { return m_pixels; }
+
+    ~DecodedImage();
+};
+
+/*
+ * A decoded image that keeps the samples of the file, up to 16 bits,
+ * so its levels can be adjusted without decoding it again.
+ *
+ * A pixel has 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA) samples.
+ */
+class DecodedWideImage final
+{
+private:
+    uint32_t m_widthPx{};
+    uint32_t m_heightPx{};
+    uint32_t m_samplesPerPixel{};
+    // The value of white and opaque
+    uint16_t m_maxSampleVal{};
+    std::vector<uint16_t> m_samples;
+    // The pixels after these are missing from the file, they are left transparent
+    size_t m_decodedPixelCount{};
+
+public:
+    DecodedWideImage(uint32_t widthPx, uint32_t heightPx, uint32_t samplesPerPixel, uint16_t maxSampleVal);
+
+    DecodedWideImage(const DecodedWideImage&) = delete;
+    DecodedWideImage& operator=(const DecodedWideImage&) = delete;
+
+    inline uint32_t getWidthPx() const { return m_widthPx; }
+    inline uint32_t getHeightPx() const { return m_heightPx; }
+    inline uint32_t getSamplesPerPixel() const { return m_samplesPerPixel; }
+    inline uint16_t getMaxSampleVal() const { return m_maxSampleVal; }
+    inline size_t getSizeInBytes() const { return m_samples.size() * sizeof(uint16_t); }
+
+    inline uint16_t* getSamples() { return m_samples.data(); }
+    inline const uint16_t* getSamples() const { return m_samples.data(); }
+    inline void setDecodedPixelCount(size_t count) { m_decodedPixelCount = std::min(count, m_decodedPixelCount); }
+
+    /*
+     * Builds the table that maps every 16-bit sample to 8 bits, so the samples in a window
+     * `windowWidth` wide around `windowCenter` go from black to white.
+     * The samples below the window are black, the ones above it are white.
+     */
+    static void buildLevelsTable(double windowCenter, double windowWidth, std::vector<uint8_t>* tableOut);
+
+    /*
+     * Converts the image to RGBA32 pixels, mapping the color samples through `levelsTable`,
+     * a table built by `buildLevelsTable()`. The alpha samples are only scaled.
+     * The pixel array must be the size of the image.
+     */
+    void renderToPixelArray(const std::vector<uint8_t>& levelsTable, uint8_t* pixelArray) const;
+};
+
+/*
+ * Recycles the surfaces of video-like sources, so showing a new frame doesn't allocate pixels.
+ *
+ * The surfaces are given out as shared pointers that put them back to the pool
+ * when the last user releases them, even if the owner of the pool is destroyed earlier.
+ */
+class DecodedImagePool final
+{
+private:
+    struct Shared
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<DecodedImage>> surfaces;
+        size_t maxFreeCount{};
+    };
+    std::shared_ptr<Shared> m_shared{std::make_shared<Shared>()};
+
+public:
+    /*
+     * At most `maxFreeCount` unused surfaces are kept, the rest are freed.
+     */
+    DecodedImagePool(size_t maxFreeCount);
+
+    DecodedImagePool(const DecodedImagePool&) = delete;
+    DecodedImagePool& operator=(const DecodedImagePool&) = delete;
+
+    /*
+     * Returns an unused surface of the size, or a new one if there is none.
+     * The pixels are not cleared.
+     */
+    std::shared_ptr<DecodedImage> get(uint32_t widthPx, uint32_t heightPx);
+};
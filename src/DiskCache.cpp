@@ -0,0 +1,353 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "DiskCache.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#define DISK_CACHE_MAGIC                "LIMGPIX1"
+#define DISK_CACHE_ENTRY_EXTENSION      ".limgpix"
+#define DISK_CACHE_TEMP_PREFIX          ".tmp-"
+// Temporary files older than this are leftovers of a crash
+#define DISK_CACHE_STALE_TEMP_AGE_SEC   600
+#define DISK_CACHE_PIXEL_ALIGNMENT      64
+
+/*
+ * The header at the beginning of every cache entry.
+ * It is followed by the path of the image and the pixels at `pixelOffset`.
+ */
+struct DiskCacheHeader
+{
+    char magic[8];
+    uint32_t widthPx;
+    uint32_t heightPx;
+    uint64_t fileSize;
+    int64_t modificationTimeNs;
+    uint32_t pathLength;
+    uint32_t pixelOffset;
+};
+
+/*
+ * Writes the whole buffer to the file, continuing after partial writes.
+ *
+ * Returns:
+ *      0, if succeded.
+ *      Nonzero if failed.
+ */
+static int writeAll(int fd, const void* buffer, size_t size)
+{
+    const uint8_t* bytes{(const uint8_t*)buffer};
+    while (size)
+    {
+        const ssize_t written{write(fd, bytes, size)};
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return 0;
+}
+
+int DiskCache::init()
+{
+    const char* xdgCacheHome{std::getenv("XDG_CACHE_HOME")};
+    const char* home{std::getenv("HOME")};
+    if (xdgCacheHome && xdgCacheHome[0] == '/')
+    {
+        m_directory = std::string{xdgCacheHome} + "/limg";
+    }
+    else if (home && home[0])
+    {
+        m_directory = std::string{home} + "/.cache/limg";
+    }
+    else
+    {
+        Logger::err << "Disk cache: Neither $XDG_CACHE_HOME nor $HOME is set" << Logger::End;
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error)
+    {
+        Logger::err << "Disk cache: Failed to create directory " << m_directory << ": " << error.message() << Logger::End;
+        return 1;
+    }
+
+    Logger::log << "Disk cache: Using " << m_directory << Logger::End;
+    // A single writer keeps the stores from competing for the disk
+    m_writerPool = std::make_unique<ThreadPool>(1);
+    return 0;
+}
+
+std::string DiskCache::_getEntryPath(const ImageCache::Key& key) const
+{
+    // 64-bit FNV-1a hash of the key
+    uint64_t hash{0xcbf29ce484222325};
+    auto hashBytes{[&hash](const void* data, size_t size){
+        for (size_t i{}; i < size; ++i)
+        {
+            hash ^= ((const uint8_t*)data)[i];
+            hash *= 0x100000001b3;
+        }
+    }};
+    hashBytes(key.filePath.data(), key.filePath.size());
+    hashBytes(&key.fileSize, sizeof(key.fileSize));
+    hashBytes(&key.modificationTimeNs, sizeof(key.modificationTimeNs));
+
+    char hashStr[17]{};
+    std::snprintf(hashStr, sizeof(hashStr), "%016llx", (unsigned long long)hash);
+    return m_directory + '/' + hashStr + DISK_CACHE_ENTRY_EXTENSION;
+}
+
+std::shared_ptr<DecodedImage> DiskCache::get(const ImageCache::Key& key)
+{
+    if (m_directory.empty())
+        return nullptr;
+
+    const std::string entryPath{_getEntryPath(key)};
+    auto miss{[this](){
+        std::lock_guard<std::mutex> lock{m_mutex};
+        ++m_stats.misses;
+        return nullptr;
+    }};
+
+    const int fd{open(entryPath.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd == -1)
+        return miss();
+
+    struct stat entryInfo{};
+    if (fstat(fd, &entryInfo) || (size_t)entryInfo.st_size < sizeof(DiskCacheHeader))
+    {
+        close(fd);
+        return miss();
+    }
+    const size_t entrySize{(size_t)entryInfo.st_size};
+
+    // A private mapping, so the pixels can be modified without touching the file
+    void* mapping{mmap(nullptr, entrySize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)};
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return miss();
+
+    DiskCacheHeader header{};
+    std::memcpy(&header, mapping, sizeof(header));
+    const bool isValid{
+        std::memcmp(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.fileSize == key.fileSize &&
+        header.modificationTimeNs == key.modificationTimeNs &&
+        header.pathLength == key.filePath.size() &&
+        sizeof(header) + header.pathLength <= header.pixelOffset &&
+        header.pixelOffset + uint64_t(header.widthPx) * header.heightPx * 4 == entrySize &&
+        std::memcmp((const uint8_t*)mapping + sizeof(header), key.filePath.data(), header.pathLength) == 0};
+    if (!isValid)
+    {
+        // A hash collision or a corrupt entry, it will be overwritten
+        munmap(mapping, entrySize);
+        return miss();
+    }
+
+    // Mark it as recently used
+    utimensat(AT_FDCWD, entryPath.c_str(), nullptr, 0);
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        ++m_stats.hits;
+    }
+    return std::make_shared<DecodedImage>(header.widthPx, header.heightPx, mapping, entrySize, header.pixelOffset);
+}
+
+int DiskCache::put(const ImageCache::Key& key, const DecodedImage& image)
+{
+    if (m_directory.empty())
+        return 1;
+
+    // It would be evicted right away
+    if (image.getSizeInBytes() > m_budgetBytes)
+        return 1;
+
+    static std::atomic<uint32_t> tempCounter{};
+    const std::string entryPath{_getEntryPath(key)};
+    const std::string tempPath{m_directory + '/' + DISK_CACHE_TEMP_PREFIX +
+        std::to_string(getpid()) + '-' + std::to_string(tempCounter++)};
+
+    const int fd{open(tempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)};
+    if (fd == -1)
+    {
+        Logger::err << "Disk cache: Failed to create file: " << std::strerror(errno) << Logger::End;
+        return 1;
+    }
+
+    DiskCacheHeader header{};
+    std::memcpy(header.magic, DISK_CACHE_MAGIC, sizeof(header.magic));
+    header.widthPx = image.getWidthPx();
+    header.heightPx = image.getHeightPx();
+    header.fileSize = key.fileSize;
+    header.modificationTimeNs = key.modificationTimeNs;
+    header.pathLength = key.filePath.size();
+    header.pixelOffset = uint32_t(
+            (sizeof(header) + header.pathLength + DISK_CACHE_PIXEL_ALIGNMENT - 1)
+            / DISK_CACHE_PIXEL_ALIGNMENT * DISK_CACHE_PIXEL_ALIGNMENT);
+
+    std::vector<uint8_t> headerBytes(header.pixelOffset);
+    std::memcpy(headerBytes.data(), &header, sizeof(header));
+    std::memcpy(headerBytes.data() + sizeof(header), key.filePath.data(), header.pathLength);
+
+    // The data must reach the disk before the rename, otherwise
+    // a crash could leave an empty or partial file under the final name
+    if (writeAll(fd, headerBytes.data(), headerBytes.size()) ||
+        writeAll(fd, image.getPixels(), image.getSizeInBytes()) ||
+        fsync(fd))
+    {
+        Logger::err << "Disk cache: Failed to write file: " << std::strerror(errno) << Logger::End;
+        close(fd);
+        unlink(tempPath.c_str());
+        return 1;
+    }
+    close(fd);
+
+    if (rename(tempPath.c_str(), entryPath.c_str()))
+    {
+        Logger::err << "Disk cache: Failed to rename file: " << std::strerror(errno) << Logger::End;
+        unlink(tempPath.c_str());
+        return 1;
+    }
+
+    // The rename is only durable once the directory reaches the disk.
+    // The entry is complete either way, so a failure is not an error.
+    const int dirFd{open(m_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (dirFd == -1 || fsync(dirFd))
+        Logger::warn << "Disk cache: Failed to sync directory: " << std::strerror(errno) << Logger::End;
+    if (dirFd != -1)
+        close(dirFd);
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        ++m_stats.stores;
+    }
+    _evictIfNeeded();
+    return 0;
+}
+
+void DiskCache::putAsync(const ImageCache::Key& key, std::shared_ptr<const DecodedImage> image)
+{
+    if (!m_writerPool)
+        return;
+
+    m_writerPool->post([this, key, image{std::move(image)}](){
+        put(key, *image);
+    });
+}
+
+void DiskCache::_evictIfNeeded()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    struct Entry
+    {
+        std::filesystem::path path;
+        uint64_t size{};
+        std::filesystem::file_time_type lastUsed;
+    };
+    std::vector<Entry> entries;
+    uint64_t totalSize{};
+
+    std::error_code error;
+    const auto now{std::filesystem::file_time_type::clock::now()};
+    for (const auto& file : std::filesystem::directory_iterator{m_directory, error})
+    {
+        const std::string fileName{file.path().filename().string()};
+        const auto lastWriteTime{file.last_write_time(error)};
+        if (error)
+            continue;
+
+        if (fileName.rfind(DISK_CACHE_TEMP_PREFIX, 0) == 0)
+        {
+            if (now - lastWriteTime > std::chrono::seconds{DISK_CACHE_STALE_TEMP_AGE_SEC})
+                std::filesystem::remove(file.path(), error);
+            continue;
+        }
+
+        if (file.path().extension() != DISK_CACHE_ENTRY_EXTENSION)
+            continue;
+
+        const uint64_t size{file.file_size(error)};
+        if (error)
+            continue;
+        entries.push_back({file.path(), size, lastWriteTime});
+        totalSize += size;
+    }
+
+    if (totalSize <= m_budgetBytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b){ return a.lastUsed < b.lastUsed; });
+    for (const auto& entry : entries)
+    {
+        if (totalSize <= m_budgetBytes)
+            break;
+        // Mapped entries stay valid after the unlink
+        if (std::filesystem::remove(entry.path, error))
+        {
+            totalSize -= entry.size;
+            ++m_stats.evictions;
+        }
+    }
+}
+
+DiskCache::Stats DiskCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_stats;
+}
+
+void DiskCache::logStats() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    Logger::log << std::dec << "Disk cache: " <<
+        m_stats.hits << " hit(s), " <<
+        m_stats.misses << " miss(es), " <<
+        m_stats.stores << " store(s), " <<
+        m_stats.evictions << " eviction(s)" << Logger::End;
+}
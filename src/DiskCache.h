@@ -0,0 +1,122 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "DecodedImage.h"
+#include "ImageCache.h"
+#include "ThreadPool.h"
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#define DISK_CACHE_DEFAULT_BUDGET_MIB 1024
+
+/*
+ * A persistent cache of decoded images, used for the formats that are slow to decode.
+ *
+ * The entries are stored in `$XDG_CACHE_HOME/limg` (or `~/.cache/limg`), one file
+ * per image, named after the hash of the cache key (path, size and modification time).
+ * An entry contains a small header, the path of the image and the raw RGBA32 pixels,
+ * so a cached image is simply memory mapped, without any decoding.
+ *
+ * Entries are written to a temporary file that is renamed into place when complete,
+ * so a crash never leaves a partially written entry behind.
+ * The loader stores them on a writer thread, so showing an image never waits for the disk.
+ * When the cache grows over its budget, the least recently used entries are deleted.
+ *
+ * All methods are thread-safe.
+ */
+class DiskCache final
+{
+public:
+    struct Stats
+    {
+        uint64_t hits{};
+        uint64_t misses{};
+        uint64_t stores{};
+        uint64_t evictions{};
+    };
+
+private:
+    std::string m_directory;
+    uint64_t m_budgetBytes{};
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+
+    // Runs the background stores, created by `init()`.
+    // Declared last, so it finishes the running store before the other members are destroyed.
+    std::unique_ptr<ThreadPool> m_writerPool;
+
+    std::string _getEntryPath(const ImageCache::Key& key) const;
+    void _evictIfNeeded();
+
+public:
+    DiskCache(uint64_t budgetBytes)
+        : m_budgetBytes{budgetBytes}
+    {
+    }
+
+    /*
+     * Finds out the location of the cache and creates the directory if needed.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed, the cache cannot be used then.
+     */
+    int init();
+
+    /*
+     * Maps the cached image.
+     *
+     * Returns:
+     *      The image, if it is in the cache.
+     *      nullptr otherwise.
+     */
+    std::shared_ptr<DecodedImage> get(const ImageCache::Key& key);
+
+    /*
+     * Writes the image to the cache, evicting the least recently used entries if needed.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int put(const ImageCache::Key& key, const DecodedImage& image);
+
+    /*
+     * Writes the image to the cache on the writer thread, like `put()`.
+     * The image is kept alive until it is written.
+     * The stores not started yet when the cache is destroyed are dropped.
+     */
+    void putAsync(const ImageCache::Key& key, std::shared_ptr<const DecodedImage> image);
+
+    Stats getStats() const;
+    void logStats() const;
+};
@@ -0,0 +1,166 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Gfx.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Gfx
+{
+
+void expandGrayToRgba(const uint8_t* grays, size_t pixelCount, uint8_t* rgbaOut)
+{
+    size_t i{};
+#ifdef __SSE2__
+    const __m128i alphas{_mm_set1_epi8(-1)};
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        const __m128i gray{_mm_loadu_si128((const __m128i*)(grays + i))};
+        // Pairs of gray-gray and gray-alpha bytes, interleaved to gray-gray-gray-alpha
+        const __m128i grayGrayLo{_mm_unpacklo_epi8(gray, gray)};
+        const __m128i grayGrayHi{_mm_unpackhi_epi8(gray, gray)};
+        const __m128i grayAlphaLo{_mm_unpacklo_epi8(gray, alphas)};
+        const __m128i grayAlphaHi{_mm_unpackhi_epi8(gray, alphas)};
+        __m128i* out{(__m128i*)(rgbaOut + i * 4)};
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(grayGrayLo, grayAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(grayGrayHi, grayAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(grayGrayHi, grayAlphaHi));
+    }
+#endif
+    for (; i < pixelCount; ++i)
+    {
+        rgbaOut[i * 4 + 0] = grays[i];
+        rgbaOut[i * 4 + 1] = grays[i];
+        rgbaOut[i * 4 + 2] = grays[i];
+        rgbaOut[i * 4 + 3] = 255;
+    }
+}
+
+void expandGrayAlphaToRgba(const uint8_t* grayAlphas, size_t pixelCount, uint8_t* rgbaOut)
+{
+    for (size_t i{}; i < pixelCount; ++i)
+    {
+        rgbaOut[i * 4 + 0] = grayAlphas[i * 2];
+        rgbaOut[i * 4 + 1] = grayAlphas[i * 2];
+        rgbaOut[i * 4 + 2] = grayAlphas[i * 2];
+        rgbaOut[i * 4 + 3] = grayAlphas[i * 2 + 1];
+    }
+}
+
+void expandRgbToRgba(const uint8_t* rgbs, size_t pixelCount, uint8_t* rgbaOut)
+{
+    size_t i{};
+#ifdef __SSE2__
+    // Pixel n of the 4 is moved n bytes up by a whole register shift, then masked out of it
+    const __m128i pixel0Mask{_mm_setr_epi32(0x00ffffff, 0, 0, 0)};
+    const __m128i pixel1Mask{_mm_setr_epi32(0, 0x00ffffff, 0, 0)};
+    const __m128i pixel2Mask{_mm_setr_epi32(0, 0, 0x00ffffff, 0)};
+    const __m128i pixel3Mask{_mm_setr_epi32(0, 0, 0, 0x00ffffff)};
+    const __m128i alphas{_mm_set1_epi32(int32_t(0xff000000))};
+    // Loads 16 bytes to use 12, stop before reading past the end
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        const __m128i rgb{_mm_loadu_si128((const __m128i*)(rgbs + i * 3))};
+        __m128i rgba{_mm_or_si128(_mm_and_si128(rgb, pixel0Mask), alphas)};
+        rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 1), pixel1Mask));
+        rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 2), pixel2Mask));
+        rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 3), pixel3Mask));
+        _mm_storeu_si128((__m128i*)(rgbaOut + i * 4), rgba);
+    }
+#else
+    // Copy 4 bytes at a time and overwrite the 4th one with the alpha
+    const uint8_t alphaBytes[4]{0, 0, 0, 255};
+    uint32_t alpha;
+    std::memcpy(&alpha, alphaBytes, 4);
+    for (; i + 2 <= pixelCount; ++i)
+    {
+        uint32_t pixel;
+        std::memcpy(&pixel, rgbs + i * 3, 4);
+        pixel |= alpha;
+        std::memcpy(rgbaOut + i * 4, &pixel, 4);
+    }
+#endif
+    for (; i < pixelCount; ++i)
+    {
+        rgbaOut[i * 4 + 0] = rgbs[i * 3 + 0];
+        rgbaOut[i * 4 + 1] = rgbs[i * 3 + 1];
+        rgbaOut[i * 4 + 2] = rgbs[i * 3 + 2];
+        rgbaOut[i * 4 + 3] = 255;
+    }
+}
+
+void loadBe16(const uint8_t* values, size_t count, uint16_t* valuesOut)
+{
+    size_t i{};
+#ifdef __SSE2__
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i words{_mm_loadu_si128((const __m128i*)(values + i * 2))};
+        const __m128i swapped{_mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8))};
+        _mm_storeu_si128((__m128i*)(valuesOut + i), swapped);
+    }
+#endif
+    for (; i < count; ++i)
+        valuesOut[i] = uint16_t(values[i * 2] << 8 | values[i * 2 + 1]);
+}
+
+void scaleBe16To8(const uint8_t* values, size_t count, uint8_t* valuesOut)
+{
+    /*
+     * round(v * 255 / 65535) is round(v / 257), which is (t - (t >> 8)) >> 8,
+     * where t is v + 128 saturated to 16 bits.
+     */
+    size_t i{};
+#ifdef __SSE2__
+    const __m128i halves{_mm_set1_epi16(128)};
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i words[2];
+        for (int j{}; j < 2; ++j)
+        {
+            const __m128i bigEndian{_mm_loadu_si128((const __m128i*)(values + (i + j * 8) * 2))};
+            const __m128i word{_mm_or_si128(_mm_slli_epi16(bigEndian, 8), _mm_srli_epi16(bigEndian, 8))};
+            const __m128i rounded{_mm_adds_epu16(word, halves)};
+            words[j] = _mm_srli_epi16(_mm_sub_epi16(rounded, _mm_srli_epi16(rounded, 8)), 8);
+        }
+        _mm_storeu_si128((__m128i*)(valuesOut + i), _mm_packus_epi16(words[0], words[1]));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const uint32_t rounded{std::min(uint32_t(values[i * 2] << 8 | values[i * 2 + 1]) + 128, 65535u)};
+        valuesOut[i] = uint8_t((rounded - (rounded >> 8)) >> 8);
+    }
+}
+
+} // End of namespace
@@ -29,6 +29,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 namespace Gfx
 {
@@ -54,5 +55,30 @@ inline void drawPointAt(
     pixelArray[offset + 3] = color.a;
 }
 
+/*
+ * Expands 8-bit gray values to opaque RGBA pixels.
+ */
+void expandGrayToRgba(const uint8_t* grays, size_t pixelCount, uint8_t* rgbaOut);
+
+/*
+ * Expands pairs of 8-bit gray and alpha values to RGBA pixels.
+ */
+void expandGrayAlphaToRgba(const uint8_t* grayAlphas, size_t pixelCount, uint8_t* rgbaOut);
+
+/*
+ * Expands packed 8-bit RGB values to opaque RGBA pixels.
+ */
+void expandRgbToRgba(const uint8_t* rgbs, size_t pixelCount, uint8_t* rgbaOut);
+
+/*
+ * Converts big-endian 16-bit values to native ones.
+ */
+void loadBe16(const uint8_t* values, size_t count, uint16_t* valuesOut);
+
+/*
+ * Scales big-endian 16-bit values to 8 bits, rounding to the nearest value.
+ */
+void scaleBe16To8(const uint8_t* values, size_t count, uint8_t* valuesOut);
+
 } // End of namespace
 
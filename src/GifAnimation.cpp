@@ -0,0 +1,443 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "GifAnimation.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+int GifAnimation::open(const std::string& filePath)
+{
+    if (m_image.open(filePath))
+        return 1;
+    if (!isAnimated())
+        return 0;
+
+    const size_t frameCount{m_image.getFrameCount()};
+    const size_t frameSize{size_t(m_image.getWidthPx()) * m_image.getHeightPx() * 4};
+    const size_t ringSize{std::max<size_t>(2, std::min<size_t>(GIF_ANIMATION_MAX_RING_SIZE,
+            size_t(GIF_ANIMATION_RING_BUDGET_MIB) * 1024 * 1024 / std::max<size_t>(frameSize, 1)))};
+    m_ring.resize(ringSize);
+    for (auto& frame : m_ring)
+        frame.pixels = std::make_unique<DecodedImage>(m_image.getWidthPx(), m_image.getHeightPx());
+
+    // Spread the keyframes the budget allows evenly, the first one is the empty canvas
+    const size_t maxKeyframeCount{size_t(GIF_ANIMATION_KEYFRAME_BUDGET_MIB) * 1024 * 1024 / std::max<size_t>(frameSize, 1)};
+    m_keyframeInterval = std::max<size_t>(GIF_ANIMATION_MIN_KEYFRAME_INTERVAL,
+            (frameCount + maxKeyframeCount) / (maxKeyframeCount + 1));
+    m_keyframes.resize((frameCount - 1) / m_keyframeInterval + 1);
+
+    m_decompressPool = std::make_unique<ThreadPool>();
+    // One job for the composited frame, the others decompress ahead
+    const size_t indicesSize{m_image.getMaxFramePixelCount()};
+    const size_t decompressJobCount{1 + std::max<size_t>(1, std::min<size_t>({
+            frameCount - 1,
+            m_decompressPool->getWorkerCount() * GIF_ANIMATION_DECOMPRESS_AHEAD_PER_WORKER,
+            size_t(GIF_ANIMATION_DECOMPRESS_BUDGET_MIB) * 1024 * 1024 / std::max<size_t>(indicesSize, 1)}))};
+    m_decompressJobs.resize(decompressJobCount);
+    m_decompressArena.resize(decompressJobCount * indicesSize);
+    for (size_t i{}; i < decompressJobCount; ++i)
+        m_decompressJobs[i].indices = m_decompressArena.data() + i * indicesSize;
+
+    Logger::log << std::dec << "Playing " << frameCount << " frames, decoding up to " <<
+        ringSize << " frames ahead, keyframe every " << m_keyframeInterval << " frames, decompressing up to " <<
+        decompressJobCount - 1 << " frames ahead in parallel" << Logger::End;
+
+    m_nextFrameDeadline = std::chrono::steady_clock::now();
+    m_decoderThread = std::thread{&GifAnimation::_decoderLoop, this};
+    return 0;
+}
+
+void GifAnimation::_storeKeyframe(size_t frameI, const std::vector<uint8_t>& canvas)
+{
+    if (frameI == 0 || frameI % m_keyframeInterval)
+        return;
+    std::vector<uint8_t>& keyframe{m_keyframes[frameI / m_keyframeInterval]};
+    if (keyframe.empty())
+        keyframe = canvas;
+}
+
+void GifAnimation::_runDecompressJob(DecompressJob* job)
+{
+    bool isCancelled{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        isCancelled = job->isCancelled;
+    }
+    if (!isCancelled)
+        job->status = m_image.decompressFrame(job->frameI, &job->decoder, job->indices, &job->rowCount);
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        job->isBusy = false;
+    }
+    m_frameDecompressedCond.notify_all();
+}
+
+bool GifAnimation::_compositeFrame(size_t frameI, std::vector<uint8_t>* canvas)
+{
+    const size_t frameCount{m_image.getFrameCount()};
+    const size_t jobCount{m_decompressJobs.size()};
+
+    // The playback jumped, the frames decompressed ahead are not needed.
+    // The cancelled jobs are reused last, so the running ones have time to finish.
+    if (m_queuedDecompressJobCount && m_decompressJobs[m_decompressJobStart].frameI != frameI)
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            for (size_t i{}; i < m_queuedDecompressJobCount; ++i)
+                m_decompressJobs[(m_decompressJobStart + i) % jobCount].isCancelled = true;
+        }
+        m_decompressJobStart = (m_decompressJobStart + m_queuedDecompressJobCount) % jobCount;
+        m_queuedDecompressJobCount = 0;
+    }
+
+    // Keep decompressing ahead in the playback order
+    size_t nextFrameI{m_queuedDecompressJobCount
+        ? (m_decompressJobs[(m_decompressJobStart + m_queuedDecompressJobCount - 1) % jobCount].frameI + 1) % frameCount
+        : frameI};
+    for (; m_queuedDecompressJobCount < jobCount; ++m_queuedDecompressJobCount)
+    {
+        DecompressJob* const job{&m_decompressJobs[(m_decompressJobStart + m_queuedDecompressJobCount) % jobCount]};
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            if (job->isBusy)
+            {
+                // A cancelled job is still running, only wait for it if the composited frame needs it
+                if (m_queuedDecompressJobCount)
+                    break;
+                m_frameDecompressedCond.wait(lock, [this, job](){ return m_isStopping || !job->isBusy; });
+                if (m_isStopping)
+                    return false;
+            }
+            job->frameI = nextFrameI;
+            job->isBusy = true;
+            job->isCancelled = false;
+        }
+        // Only two pointers are captured, so the task fits in `std::function` without allocating
+        m_decompressPool->post([this, job](){ _runDecompressJob(job); });
+        nextFrameI = (nextFrameI + 1) % frameCount;
+    }
+
+    DecompressJob& job{m_decompressJobs[m_decompressJobStart]};
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_frameDecompressedCond.wait(lock, [this, &job](){ return m_isStopping || !job.isBusy; });
+        if (m_isStopping)
+            return false;
+    }
+
+    if (!job.status)
+        m_image.compositeDecompressedFrame(frameI, job.indices, job.rowCount, canvas->data());
+    m_decompressJobStart = (m_decompressJobStart + 1) % jobCount;
+    --m_queuedDecompressJobCount;
+    return true;
+}
+
+bool GifAnimation::_seekCanvas(
+        size_t targetFrameI, size_t* frameIInOut,
+        std::vector<uint8_t>* canvas, std::vector<uint8_t>* canvasBeforeFrame)
+{
+    // The nearest keyframe that is already taken
+    size_t keyframeI{targetFrameI / m_keyframeInterval};
+    while (keyframeI && m_keyframes[keyframeI].empty())
+        --keyframeI;
+    const size_t keyframeFrameI{keyframeI * m_keyframeInterval};
+
+    size_t& frameI{*frameIInOut};
+    // Continue from the current canvas if it is closer
+    if (frameI <= keyframeFrameI || frameI > targetFrameI)
+    {
+        if (keyframeI)
+            *canvas = m_keyframes[keyframeI];
+        else
+            std::fill(canvas->begin(), canvas->end(), 0);
+        frameI = keyframeFrameI;
+    }
+
+    for (; frameI < targetFrameI; ++frameI)
+    {
+        _storeKeyframe(frameI, *canvas);
+        if (m_image.needsCanvasBeforeFrame(frameI))
+            *canvasBeforeFrame = *canvas;
+        if (!_compositeFrame(frameI, canvas))
+            return false;
+        m_image.disposeFrame(frameI, canvas->data(), canvasBeforeFrame->data());
+    }
+    return true;
+}
+
+void GifAnimation::_decoderLoop()
+{
+    const size_t frameCount{m_image.getFrameCount()};
+    const uint32_t playCount{m_image.getPlayCount()};
+    const size_t canvasSize{size_t(m_image.getWidthPx()) * m_image.getHeightPx() * 4};
+    // The frames are composited on this, it keeps the result of the previous frames
+    std::vector<uint8_t> canvas(canvasSize);
+    // The canvas before the current frame, for the "restore previous" disposal method
+    std::vector<uint8_t> canvasBeforeFrame;
+    // The area cleared or restored by the disposal of the previous frame
+    SDL_Rect disposedRect{};
+    // The texture may contain any frame after a seek
+    bool isFrameFullyDirty{true};
+
+    size_t frameI{};
+    uint32_t playI{};
+    while (true)
+    {
+        size_t slotI{};
+        uint64_t generation{};
+        bool isSeeking{};
+        size_t seekTargetFrameI{};
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_ringChangedCond.wait(lock, [this](){
+                return m_isStopping || m_isSeekPending || (!m_isDecodingFinished && m_ringFrameCount < m_ring.size());
+            });
+            if (m_isStopping)
+                return;
+            if (m_isSeekPending)
+            {
+                isSeeking = true;
+                seekTargetFrameI = m_seekTargetFrameI;
+                m_isSeekPending = false;
+                m_isDecodingFinished = false;
+            }
+            slotI = (m_ringStart + m_ringFrameCount) % m_ring.size();
+            generation = m_ringGeneration;
+        }
+
+        if (isSeeking)
+        {
+            if (!_seekCanvas(seekTargetFrameI, &frameI, &canvas, &canvasBeforeFrame))
+                return;
+            disposedRect = {};
+            isFrameFullyDirty = true;
+            // Play the last round again if the animation was over
+            if (playCount && playI >= playCount)
+                playI = playCount - 1;
+            continue;
+        }
+
+        // Every play starts with an empty canvas
+        if (frameI == 0)
+            std::fill(canvas.begin(), canvas.end(), 0);
+        _storeKeyframe(frameI, canvas);
+        if (m_image.needsCanvasBeforeFrame(frameI))
+            canvasBeforeFrame = canvas;
+
+        // The slot is not in the visible part of the ring, the main thread doesn't touch it
+        Frame& slot{m_ring[slotI]};
+        if (!_compositeFrame(frameI, &canvas))
+            return;
+        std::memcpy(slot.pixels->getPixels(), canvas.data(), canvasSize);
+        slot.frameI = frameI;
+        slot.delayMs = m_image.getFrameDelayMs(frameI);
+        if (frameI == 0 || isFrameFullyDirty)
+        {
+            slot.dirtyRect = {0, 0, (int)m_image.getWidthPx(), (int)m_image.getHeightPx()};
+        }
+        else
+        {
+            const SDL_Rect frameRect{m_image.getFrameRect(frameI)};
+            SDL_UnionRect(&disposedRect, &frameRect, &slot.dirtyRect);
+        }
+        isFrameFullyDirty = false;
+
+        m_image.disposeFrame(frameI, canvas.data(), canvasBeforeFrame.data());
+        disposedRect = m_image.isDisposalChangingCanvas(frameI) ? m_image.getFrameRect(frameI) : SDL_Rect{};
+
+        bool isFinished{};
+        if (++frameI == frameCount)
+        {
+            frameI = 0;
+            ++playI;
+            isFinished = playCount && playI >= playCount;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            // Otherwise a seek emptied the ring and this frame is not needed
+            if (generation == m_ringGeneration)
+            {
+                ++m_ringFrameCount;
+                m_isDecodingFinished = isFinished;
+            }
+        }
+        m_ringChangedCond.notify_all();
+    }
+}
+
+const GifAnimation::Frame* GifAnimation::takeFrameToShow()
+{
+    if (m_ring.empty() || m_isFrameTaken)
+        return nullptr;
+    if (m_isPaused ? !m_isShowPending : std::chrono::steady_clock::now() < m_nextFrameDeadline)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_ringFrameCount)
+        return nullptr;
+
+    m_isFrameTaken = true;
+    return &m_ring[m_ringStart];
+}
+
+int GifAnimation::uploadTakenFrame(SDL_Texture* texture)
+{
+    if (!m_isFrameTaken)
+        return 1;
+
+    const Frame& frame{m_ring[m_ringStart]};
+    const SDL_Rect& rect{frame.dirtyRect};
+    const size_t rowSize{size_t(rect.w) * 4};
+    m_stats.lastFrameUploadedBytes = rowSize * rect.h;
+    m_stats.uploadedBytes += m_stats.lastFrameUploadedBytes;
+    m_stats.fullFrameBytes += frame.pixels->getSizeInBytes();
+    ++m_stats.uploadedFrames;
+    // Nothing changed, e.g. the frame is outside the logical screen
+    if (rect.w <= 0 || rect.h <= 0)
+        return 0;
+
+    uint8_t* texturePixels{};
+    int texturePitch{};
+    if (SDL_LockTexture(texture, &rect, (void**)&texturePixels, &texturePitch))
+    {
+        Logger::err << "Failed to lock texture: " << SDL_GetError() << Logger::End;
+        return 1;
+    }
+    const uint8_t* framePixels{frame.pixels->getPixels() + size_t(rect.y) * frame.pixels->getPitch() + rect.x * 4};
+    for (int rowI{}; rowI < rect.h; ++rowI)
+    {
+        std::memcpy(texturePixels, framePixels, rowSize);
+        texturePixels += texturePitch;
+        framePixels += frame.pixels->getPitch();
+    }
+    SDL_UnlockTexture(texture);
+    return 0;
+}
+
+void GifAnimation::finishFrame()
+{
+    if (!m_isFrameTaken)
+        return;
+    m_isFrameTaken = false;
+    m_isShowPending = false;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_shownFrameI = m_ring[m_ringStart].frameI;
+        m_shownFrameDelayMs = m_ring[m_ringStart].delayMs;
+        m_ringStart = (m_ringStart + 1) % m_ring.size();
+        --m_ringFrameCount;
+    }
+    m_ringChangedCond.notify_all();
+
+    // The deadline is not based on the current time, so the delays don't add up
+    const auto now{std::chrono::steady_clock::now()};
+    m_nextFrameDeadline += std::chrono::milliseconds{m_shownFrameDelayMs};
+    if (now - m_nextFrameDeadline > std::chrono::milliseconds{GIF_ANIMATION_MAX_LATENESS_MS})
+        m_nextFrameDeadline = now;
+}
+
+int GifAnimation::getMsUntilNextFrame()
+{
+    if (m_ring.empty() || (m_isPaused && !m_isShowPending))
+        return -1;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_ringFrameCount)
+            return m_isDecodingFinished ? -1 : GIF_ANIMATION_UNDERRUN_WAIT_MS;
+    }
+    if (m_isPaused)
+        return 0;
+
+    const auto untilDeadline{std::chrono::ceil<std::chrono::milliseconds>(
+            m_nextFrameDeadline - std::chrono::steady_clock::now()).count()};
+    return (int)std::max(0l, (long)untilDeadline);
+}
+
+void GifAnimation::setPaused(bool value)
+{
+    if (m_ring.empty() || value == m_isPaused)
+        return;
+    m_isPaused = value;
+    // The shown frame gets its full delay after resuming
+    if (!m_isPaused)
+        m_nextFrameDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{m_shownFrameDelayMs};
+}
+
+void GifAnimation::seekToFrame(size_t frameI)
+{
+    if (m_ring.empty() || m_isFrameTaken)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        ++m_ringGeneration;
+        m_ringFrameCount = 0;
+        m_isSeekPending = true;
+        m_seekTargetFrameI = frameI % m_image.getFrameCount();
+    }
+    m_ringChangedCond.notify_all();
+
+    m_isShowPending = true;
+    m_nextFrameDeadline = std::chrono::steady_clock::now();
+}
+
+void GifAnimation::stepFrames(long count)
+{
+    if (m_ring.empty())
+        return;
+    const long frameCount{(long)m_image.getFrameCount()};
+    // Repeated steps add up, even if the target of the previous one is not shown yet
+    const size_t fromFrameI{m_isShowPending ? m_seekTargetFrameI : m_shownFrameI};
+    seekToFrame(size_t(((long)fromFrameI + count % frameCount + frameCount) % frameCount));
+}
+
+void GifAnimation::logStats() const
+{
+    Logger::log << std::dec << "Animation: " <<
+        m_stats.uploadedFrames << " frame(s) uploaded, " <<
+        m_stats.uploadedBytes << '/' << m_stats.fullFrameBytes << " bytes (dirty/full), " <<
+        m_stats.lastFrameUploadedBytes << " bytes in the last frame" << Logger::End;
+}
+
+GifAnimation::~GifAnimation()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_isStopping = true;
+    }
+    m_ringChangedCond.notify_all();
+    m_frameDecompressedCond.notify_all();
+    if (m_decoderThread.joinable())
+        m_decoderThread.join();
+    // The running decompressions use the image
+    m_decompressPool.reset();
+}
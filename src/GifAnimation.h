@@ -0,0 +1,249 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "GifImage.h"
+#include "DecodedImage.h"
+#include "LzwDecoder.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The composited frames decoded ahead are stored in a ring of at most this many frames
+#define GIF_ANIMATION_MAX_RING_SIZE     8
+// and at most this much memory, but at least 2 frames
+#define GIF_ANIMATION_RING_BUDGET_MIB   64
+// If the playback falls behind the schedule more than this (e.g. the window was hidden),
+// it continues from the current time instead of catching up
+#define GIF_ANIMATION_MAX_LATENESS_MS   1000
+// How often to check for the next frame when the decoder is late
+#define GIF_ANIMATION_UNDERRUN_WAIT_MS  2
+// The composited canvas is saved every few frames during the first play, so seeking
+// doesn't have to composite from the first frame. The snapshots use at most this much memory
+#define GIF_ANIMATION_KEYFRAME_BUDGET_MIB   64
+// Snapshots are not taken more often than this, even if the budget would allow it
+#define GIF_ANIMATION_MIN_KEYFRAME_INTERVAL 4
+// The frames after the composited one are decompressed in parallel, at most this many
+// frames per worker thread ahead
+#define GIF_ANIMATION_DECOMPRESS_AHEAD_PER_WORKER 2
+// and the color indices of the frames decompressed ahead use at most this much memory,
+// but at least one frame is decompressed ahead
+#define GIF_ANIMATION_DECOMPRESS_BUDGET_MIB       32
+
+/*
+ * Plays an animated GIF.
+ *
+ * A background thread composites the frames ahead of the display clock
+ * into a bounded ring. The frames are shown at absolute deadlines:
+ * every deadline is the previous one plus the delay of the frame,
+ * so the timing doesn't drift.
+ *
+ * The LZW data of the frames are independent, so a thread pool decompresses
+ * the frames after the one being composited, only compositing is sequential.
+ *
+ * The playback can be paused and seeked. Seeking starts compositing from
+ * the nearest keyframe: a snapshot of the canvas taken during the first play.
+ */
+class GifAnimation final
+{
+public:
+    struct Frame
+    {
+        std::unique_ptr<DecodedImage> pixels;
+        size_t frameI{};
+        uint32_t delayMs{};
+        // The part of the canvas that changed since the previous frame
+        SDL_Rect dirtyRect{};
+    };
+
+    struct Stats
+    {
+        uint64_t uploadedFrames{};
+        uint64_t uploadedBytes{};
+        // What uploading the whole frames would have cost
+        uint64_t fullFrameBytes{};
+        uint64_t lastFrameUploadedBytes{};
+    };
+
+private:
+    struct DecompressJob
+    {
+        size_t frameI{};
+        // Reused for every frame of the job, so decompression doesn't allocate
+        LzwDecoder decoder;
+        // Points into `m_decompressArena`
+        uint8_t* indices{};
+        uint32_t rowCount{};
+        int status{};
+        // Protected by `m_mutex`
+        // Posted to the thread pool and not finished yet
+        bool isBusy{};
+        bool isCancelled{};
+    };
+
+    GifImage m_image;
+
+    std::vector<Frame> m_ring;
+    // The index of the oldest frame in the ring
+    size_t m_ringStart{};
+    // Number of decoded frames in the ring
+    size_t m_ringFrameCount{};
+    // Incremented when the ring is emptied by a seek, so the decoder drops the frame it is working on
+    uint64_t m_ringGeneration{};
+    bool m_isStopping{};
+    bool m_isDecodingFinished{};
+    bool m_isSeekPending{};
+    size_t m_seekTargetFrameI{};
+    std::mutex m_mutex;
+    std::condition_variable m_ringChangedCond;
+    std::condition_variable m_frameDecompressedCond;
+    std::thread m_decoderThread;
+    std::unique_ptr<ThreadPool> m_decompressPool;
+
+    // Used only by the main thread
+    std::chrono::steady_clock::time_point m_nextFrameDeadline;
+    bool m_isFrameTaken{};
+    bool m_isPaused{};
+    // A frame is shown even if paused, after a seek
+    bool m_isShowPending{};
+    size_t m_shownFrameI{};
+    uint32_t m_shownFrameDelayMs{};
+    Stats m_stats;
+
+    // Used only by the decoder thread
+    // Keyframe `i` is the canvas before frame `i * m_keyframeInterval`, empty if not taken yet
+    std::vector<std::vector<uint8_t>> m_keyframes;
+    size_t m_keyframeInterval{1};
+    // A ring of jobs, the queued ones decompress the next frames in the order they will be composited
+    std::vector<DecompressJob> m_decompressJobs;
+    size_t m_decompressJobStart{};
+    size_t m_queuedDecompressJobCount{};
+    // The color indices of all the jobs, allocated once
+    std::vector<uint8_t> m_decompressArena;
+
+    void _decoderLoop();
+    /*
+     * Decompresses the frame of `job` on a worker thread, unless the job was cancelled.
+     */
+    void _runDecompressJob(DecompressJob* job);
+    /*
+     * Composites frame `frameI` over `canvas`, using the decompressed frames
+     * and starting the decompression of the next ones.
+     *
+     * Returns:
+     *      false if the animation is stopping.
+     */
+    bool _compositeFrame(size_t frameI, std::vector<uint8_t>* canvas);
+    /*
+     * Saves `canvas` if frame `frameI` is due a keyframe that is not taken yet.
+     */
+    void _storeKeyframe(size_t frameI, const std::vector<uint8_t>& canvas);
+    /*
+     * Composites the frames before `targetFrameI`, starting from the nearest keyframe
+     * or from `*frameIInOut` if that is closer.
+     * `*frameIInOut` is set to `targetFrameI`.
+     *
+     * Returns:
+     *      false if the animation is stopping.
+     */
+    bool _seekCanvas(
+            size_t targetFrameI, size_t* frameIInOut,
+            std::vector<uint8_t>* canvas, std::vector<uint8_t>* canvasBeforeFrame);
+
+public:
+    GifAnimation() {}
+
+    GifAnimation(const GifAnimation&) = delete;
+    GifAnimation& operator=(const GifAnimation&) = delete;
+
+    /*
+     * Opens the GIF file and starts decoding the frames if it has more than one.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int open(const std::string& filePath);
+
+    inline bool isAnimated() const { return m_image.getFrameCount() > 1; }
+    inline size_t getFrameCount() const { return m_image.getFrameCount(); }
+
+    /*
+     * Returns the frame to show, if it is time to show the next one and it is decoded.
+     * Otherwise returns nullptr and the shown frame stays.
+     * The frame is valid until `finishFrame()` is called.
+     */
+    const Frame* takeFrameToShow();
+
+    /*
+     * Copies the dirty rectangle of the frame returned by `takeFrameToShow()` to `texture`,
+     * a streaming texture that contains the previous frame.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int uploadTakenFrame(SDL_Texture* texture);
+
+    /*
+     * Releases the frame returned by `takeFrameToShow()` after it was uploaded,
+     * and schedules the next one.
+     */
+    void finishFrame();
+
+    /*
+     * Returns the time until the next frame should be shown, or -1 if the animation is over.
+     */
+    int getMsUntilNextFrame();
+
+    /*
+     * Pausing stops the frames at the shown one. Seeking still shows the target frame.
+     */
+    void setPaused(bool value);
+    inline bool isPaused() const { return m_isPaused; }
+
+    /*
+     * Drops the decoded frames and shows frame `frameI` next.
+     */
+    void seekToFrame(size_t frameI);
+    /*
+     * Seeks `count` frames forward or backward from the shown frame, wrapping around.
+     */
+    void stepFrames(long count);
+    inline size_t getShownFrameI() const { return m_shownFrameI; }
+
+    inline const Stats& getStats() const { return m_stats; }
+    void logStats() const;
+
+    ~GifAnimation();
+};
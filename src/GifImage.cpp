@@ -30,10 +30,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "LzwDecoder.h"
 #include "Logger.h"
 #include "bitmagic.h"
-#include "Gfx.h"
 #include <stdint.h>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
+#include <unordered_map>
 
 #define GIF_MAX_BUFFER_SIZE -1_u32 // 4 gigs
 #define GIF_LOGICAL_SCREEN_WIDTH_OFFS                6
@@ -42,6 +43,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define GIF_LOGICAL_SCREEN_BG_COLOR_OFFS            11
 #define GIF_LOGICAL_SCREEN_PIXEL_ASPECT_RATIO_OFFS  12
 #define GIF_AFTER_LOGICAL_SCREEN_DESCRIPTOR_OFFS    13
+// Frames with a shorter delay are shown for the default time
+#define GIF_MIN_FRAME_DELAY_CS                       2
+#define GIF_DEFAULT_FRAME_DELAY_MS                 100
 
 static std::string gifVersionToStr(GifImage::GifVersion version)
 {
@@ -63,10 +67,40 @@ static GifImage::GifVersion strToGifVersion(const char* version)
     return GifImage::GifVersion::Unknown;
 }
 
+// The first row and the row step of the passes of an interlaced image
+static constexpr uint32_t s_interlacePassStartRows[]{0, 4, 2, 1};
+static constexpr uint32_t s_interlacePassRowSteps[]{8, 8, 4, 2};
+#define GIF_INTERLACE_PASS_COUNT 4
+
+/*
+ * Returns the number of rows in pass `passI` of an interlaced image `height` rows high.
+ */
+static uint32_t getInterlacePassRowCount(int passI, uint32_t height)
+{
+    if (height <= s_interlacePassStartRows[passI])
+        return 0;
+    return (height - s_interlacePassStartRows[passI] + s_interlacePassRowSteps[passI] - 1) / s_interlacePassRowSteps[passI];
+}
+
+/*
+ * Returns the row of an interlaced image `height` rows high that is stored as the `storedRowI`th.
+ */
+static uint32_t interlacedToImageRowI(uint32_t storedRowI, uint32_t height)
+{
+    for (int passI{}; passI < GIF_INTERLACE_PASS_COUNT; ++passI)
+    {
+        const uint32_t passRowCount{getInterlacePassRowCount(passI, height)};
+        if (storedRowI < passRowCount)
+            return s_interlacePassStartRows[passI] + storedRowI * s_interlacePassRowSteps[passI];
+        storedRowI -= passRowCount;
+    }
+    return height;
+}
+
 int GifImage::open(const std::string &filepath)
 {
     m_filePath.clear();
-    std::cout << std::hex;
+    Logger::log << std::hex;
 
     auto fileObject{std::ifstream{filepath, std::ios::binary}};
     if (fileObject.fail()) // If failed to open
@@ -128,6 +162,8 @@ int GifImage::open(const std::string &filepath)
     if (_fetchLogicalScreenDescriptor())
         return 1;
 
+    // Read before the frame it belongs to
+    ImageFrame::GraphicControl graphicControl{};
     for (uint32_t offset{
             GIF_AFTER_LOGICAL_SCREEN_DESCRIPTOR_OFFS +
             (m_hasGlobalColorTable ? m_globalColorTableSizeInBytes : 0_u32)};
@@ -136,34 +172,52 @@ int GifImage::open(const std::string &filepath)
         Logger::log << "Separator byte (ASCII): '" << m_buffer[offset] << "' at 0x" << offset << Logger::End;
         switch (m_buffer[offset])
         {
+        case '!': // Extension ahead
+        {
+            if (_fetchExtension(offset, &graphicControl, &offset))
+                return 1;
+            break;
+        } // End of case '!'
+
         case ',': // Image descriptor ahead
         {
-            if (_fetchImageDescriptor(offset))
+            ImageFrame frame{};
+            if (_fetchImageDescriptor(offset, &frame))
                 return 1;
 
+            // The Graphic Control Extension only applies to the next frame
+            frame.graphicControl = graphicControl;
+            graphicControl = {};
+
             // Go thru the image descriptor
             offset += 10;
 
             // Skip the local palette if there is one
-            if (m_imageFrames.size() &&
-                m_imageFrames[m_imageFrames.size() - 1]->imageDescriptor.hasLocalColorTable)
-                offset += m_imageFrames[m_imageFrames.size() - 1]->imageDescriptor.localColorTableSizeInBytes;
-
+            if (frame.imageDescriptor.hasLocalColorTable)
+            {
+                frame.localColorTableOffset = offset;
+                offset += frame.imageDescriptor.localColorTableSizeInBytes;
+            }
 
-            // Skip the LZW minimum code size byte
+            if (offset >= m_fileSize)
+            {
+                Logger::err << "Image data out of bounds" << Logger::End;
+                return 1;
+            }
+            frame.lzwMinCodeSize = m_buffer[offset];
             ++offset;
 
-            while (offset < m_fileSize)
+            frame.dataOffset = offset;
+            offset = _skipSubBlocks(offset);
+            if (!offset)
             {
-                if (m_buffer[offset] == 0) // Block terminator
-                {
-                    Logger::log << "End of a block" << Logger::End;
-                    ++offset; // Skip the block terminator
-                    break;
-                }
-                // Skip a sub-block and the size byte
-                offset += m_buffer[offset] + 1;
+                Logger::err << "Image data is truncated" << Logger::End;
+                return 1;
             }
+            frame.dataSize = offset - frame.dataOffset;
+
+            m_imageFrames.push_back(frame);
+            break;
         } // End of case ','
 
         case ';': // End of data
@@ -171,13 +225,29 @@ int GifImage::open(const std::string &filepath)
             goto after_loop;
         } // End of case ';'
 
+        default:
+        {
+            Logger::err << "Invalid block separator: 0x" << +m_buffer[offset] << Logger::End;
+            return 1;
+        }
         } // End of switch
     }
     Logger::log << "End of file" << Logger::End;
 
 after_loop:
 
-    Logger::log << "Found " << m_imageFrames.size() << " frame(s)" << Logger::End;
+    Logger::log << std::dec << "Found " << m_imageFrames.size() << " frame(s)" << std::hex << Logger::End;
+    if (m_imageFrames.empty())
+    {
+        Logger::err << "No image frames found" << Logger::End;
+        return 1;
+    }
+    _buildPalettes();
+    for (const ImageFrame& frame : m_imageFrames)
+    {
+        m_maxFramePixelCount = std::max(m_maxFramePixelCount,
+                size_t(frame.imageDescriptor.imageWidth) * frame.imageDescriptor.imageHeight);
+    }
     m_bitmapWidthPx = m_logicalScreen.width;
     m_bitmapHeightPx = m_logicalScreen.height;
 
@@ -195,7 +265,7 @@ int GifImage::_fetchLogicalScreenDescriptor()
         return 1;
     }
 
-    std::cout << std::dec;
+    Logger::log << std::dec;
 
     std::memcpy(&m_logicalScreen.width, m_buffer + GIF_LOGICAL_SCREEN_WIDTH_OFFS, 2);
     Logger::log << "Logical screen width: " << m_logicalScreen.width << Logger::End;
@@ -246,12 +316,12 @@ int GifImage::_fetchLogicalScreenDescriptor()
         m_logicalScreen.pixelAspectRatio = 0;
     }
 
-    std::cout << std::hex;
+    Logger::log << std::hex;
 
     return 0;
 }
 
-int GifImage::_fetchImageDescriptor(uint32_t startOffset)
+int GifImage::_fetchImageDescriptor(uint32_t startOffset, ImageFrame* frameOut)
 {
     // Check if there is enough space for the descriptor
     if (m_fileSize < startOffset + 10)
@@ -260,7 +330,7 @@ int GifImage::_fetchImageDescriptor(uint32_t startOffset)
         return 1;
     }
 
-    auto imageFrame = new ImageFrame;
+    ImageFrame* const imageFrame{frameOut};
     imageFrame->startOffset = startOffset;
     // Note: We skip the separator byte
     std::memcpy(&imageFrame->imageDescriptor.imageLeftPos, m_buffer + startOffset + 1, 2);
@@ -284,7 +354,7 @@ int GifImage::_fetchImageDescriptor(uint32_t startOffset)
             imageFrame->imageDescriptor.localColorTableSizeInColors * 3;
     }
 
-    std::cout << std::dec;
+    Logger::log << std::dec;
 
     Logger::log << "Image frame: " << '\n' <<
         '\t' << "Left position: "         << imageFrame->imageDescriptor.imageLeftPos << '\n' <<
@@ -302,99 +372,376 @@ int GifImage::_fetchImageDescriptor(uint32_t startOffset)
     }
     Logger::log << Logger::End;
 
-    std::cout << std::hex;
-
-    m_imageFrames.push_back(imageFrame);
+    Logger::log << std::hex;
 
     return 0;
 }
 
-int GifImage::render(
-        SDL_Texture* texture, uint32_t viewportWidth, uint32_t viewportHeight) const
+int GifImage::_fetchExtension(
+        uint32_t startOffset, ImageFrame::GraphicControl* graphicControlOut, uint32_t* endOffsetOut)
 {
-    if (!m_isInitialized)
+    if (m_fileSize < startOffset + 2)
     {
-        Logger::err << "Cannot draw uninitialized image" << Logger::End;
+        Logger::err << "Extension out of bounds" << Logger::End;
         return 1;
     }
 
-    SDL_Rect lockRect{0, 0, (int)viewportWidth, (int)viewportHeight};
-    uint8_t* pixelArray{};
-    int pitch{};
-    if (SDL_LockTexture(texture, &lockRect, (void**)&pixelArray, &pitch))
+    // The first sub-block, after the introducer and the label
+    const uint32_t dataOffset{startOffset + 2};
+    const uint8_t label{m_buffer[startOffset + 1]};
+    switch (label)
     {
-        Logger::err << "Failed to lock texture: " << SDL_GetError() << Logger::End;
-        return 1;
-    }
+    case 0xf9: // Graphic Control Extension
+    {
+        if (m_fileSize < dataOffset + 5 || m_buffer[dataOffset] < 4)
+        {
+            Logger::err << "Invalid Graphic Control Extension" << Logger::End;
+            return 1;
+        }
 
-    // Skip image descriptor
-    uint32_t offset{m_imageFrames[0]->startOffset + 10};
+        const uint8_t flags{m_buffer[dataOffset + 1]};
+        graphicControlOut->disposalMethod = DisposalMethod((flags & 0b00011100) >> 2);
+        // Reserved values are treated as "don't dispose"
+        if ((int)graphicControlOut->disposalMethod > (int)DisposalMethod::RestorePrevious)
+            graphicControlOut->disposalMethod = DisposalMethod::DoNotDispose;
+        graphicControlOut->hasTransparentColor = !!(flags & 0b00000001);
+        std::memcpy(&graphicControlOut->delayCs, m_buffer + dataOffset + 2, 2);
+        graphicControlOut->transparentColorIndex = m_buffer[dataOffset + 4];
+
+        Logger::log << std::dec << "Graphic Control Extension: delay: " << graphicControlOut->delayCs <<
+            "cs, disposal method: " << (int)graphicControlOut->disposalMethod <<
+            ", transparent color: " << (graphicControlOut->hasTransparentColor
+                ? std::to_string(graphicControlOut->transparentColorIndex) : "none") <<
+            std::hex << Logger::End;
+        break;
+    }
 
-    // Skip the local palette if there is one
-    if (m_imageFrames.size() && m_imageFrames[m_imageFrames.size() - 1]->imageDescriptor.hasLocalColorTable)
+    case 0xff: // Application Extension
     {
-        Logger::log << "Skipping local color table" << Logger::End;
-        offset += m_imageFrames[m_imageFrames.size() - 1]->imageDescriptor.localColorTableSizeInBytes;
+        // The application identifier and authentication code are in the first sub-block
+        if (m_fileSize >= dataOffset + 12 && m_buffer[dataOffset] == 11 &&
+            (std::memcmp(m_buffer + dataOffset + 1, "NETSCAPE2.0", 11) == 0 ||
+             std::memcmp(m_buffer + dataOffset + 1, "ANIMEXTS1.0", 11) == 0))
+        {
+            // Looping sub-block: size, ID (1), loop count
+            const uint32_t loopOffset{dataOffset + 12};
+            if (m_fileSize >= loopOffset + 4 && m_buffer[loopOffset] >= 3 && m_buffer[loopOffset + 1] == 1)
+            {
+                uint16_t loopCount{};
+                std::memcpy(&loopCount, m_buffer + loopOffset + 2, 2);
+                Logger::log << std::dec << "Loop count: " << loopCount << std::hex << Logger::End;
+                // The loop count is the number of repeats after the first play
+                m_playCount = loopCount ? loopCount + 1_u32 : 0;
+            }
+        }
+        else
+        {
+            Logger::log << "Unknown application extension, ignoring" << Logger::End;
+        }
+        break;
     }
-    else
+
+    case 0xfe: // Comment Extension
     {
-        Logger::log << "No local color table, not skipping" << Logger::End;
+        Logger::log << "Comment: \"";
+        for (uint32_t offset{dataOffset}; offset < m_fileSize && m_buffer[offset];)
+        {
+            for (uint32_t i{1}; i <= m_buffer[offset] && offset + i < m_fileSize; ++i)
+                Logger::log << m_buffer[offset + i];
+            offset += m_buffer[offset] + 1;
+        }
+        Logger::log << "\"" << Logger::End;
+        break;
     }
 
-    LzwDecoder decoder{};
-    decoder.setCodeSize(m_buffer[offset++]);
-
-    while (offset < m_fileSize)
+    case 0x01: // Plain Text Extension
     {
-        uint32_t subBlockSize{m_buffer[offset]};
-        ++offset;
+        // Text rendering is not supported, but it still belongs to the next frame
+        Logger::log << "Plain Text Extension, ignoring" << Logger::End;
+        *graphicControlOut = {};
+        break;
+    }
 
-        //Logger::log << "Buffering a sub-block of 0x" << subBlockSize << " bytes" << Logger::End;
+    default:
+    {
+        Logger::log << "Unknown extension: 0x" << +label << ", ignoring" << Logger::End;
+        break;
+    }
+    }
 
-        for (int i{}; i < subBlockSize; ++i)
-            decoder << m_buffer[offset + i];
+    *endOffsetOut = _skipSubBlocks(dataOffset);
+    if (!*endOffsetOut)
+    {
+        Logger::err << "Extension is truncated" << Logger::End;
+        return 1;
+    }
+    return 0;
+}
 
-        offset += subBlockSize;
+uint32_t GifImage::_skipSubBlocks(uint32_t offset) const
+{
+    while (offset < m_fileSize)
+    {
         if (m_buffer[offset] == 0) // Block terminator
+            return offset + 1;
+        // Skip a sub-block and the size byte
+        offset += m_buffer[offset] + 1;
+    }
+    return 0;
+}
+
+void GifImage::_buildPalettes()
+{
+    // The palettes by color table offset and transparent index (256 if there is none)
+    std::unordered_map<uint64_t, uint32_t> paletteIs;
+    for (ImageFrame& frame : m_imageFrames)
+    {
+        const bool hasLocalColorTable{frame.imageDescriptor.hasLocalColorTable};
+        const uint32_t colorTableOffset{hasLocalColorTable
+            ? frame.localColorTableOffset : GIF_AFTER_LOGICAL_SCREEN_DESCRIPTOR_OFFS};
+        const int colorCount{hasLocalColorTable
+            ? frame.imageDescriptor.localColorTableSizeInColors
+            : (m_hasGlobalColorTable ? m_globalColorTableSizeInColors : 0)};
+        const uint32_t transparentIndex{frame.graphicControl.hasTransparentColor
+            ? frame.graphicControl.transparentColorIndex : 256_u32};
+
+        const auto inserted{paletteIs.emplace(
+                (uint64_t(colorTableOffset) << 9) | transparentIndex, (uint32_t)m_palettes.size())};
+        frame.paletteI = inserted.first->second;
+        if (!inserted.second)
+            continue;
+
+        palette_t& palette{m_palettes.emplace_back()};
+        for (int i{}; i < 256; ++i)
         {
-            Logger::log << "End of a block" << Logger::End;
-            ++offset; // Skip the block terminator
-            goto end_of_block;
+            // The colors missing from the table are black
+            uint8_t color[4]{0, 0, 0, 255};
+            if (i < colorCount)
+                std::memcpy(color, m_buffer + colorTableOffset + i * 3, 3);
+            if ((uint32_t)i == transparentIndex)
+                color[3] = 0;
+            std::memcpy(&palette[i], color, 4);
         }
     }
-end_of_block:
-        ;
+    Logger::log << std::dec << "Built " << m_palettes.size() << " color lookup table(s)" << std::hex << Logger::End;
+}
 
-    auto decompressedData = decoder.getDecompressedData();
-    unsigned int xPos{};
-    unsigned int yPos{};
-    for (int i{}; i < decompressedData.size(); ++i)
+void GifImage::_drawRow(
+        const ImageFrame& frame,
+        uint32_t rowI, const uint8_t* indices, uint32_t length,
+        uint8_t* canvas, uint32_t visibleWidth, uint32_t visibleHeight) const
+{
+    const ImageFrame::ImageDescriptor& descriptor{frame.imageDescriptor};
+    const uint32_t yPos{descriptor.imageTopPos + rowI};
+    if (yPos >= visibleHeight || descriptor.imageLeftPos >= visibleWidth)
+        return;
+
+    const palette_t& palette{m_palettes[frame.paletteI]};
+    const uint32_t pixelCount{std::min(length, visibleWidth - descriptor.imageLeftPos)};
+    uint8_t* dest{canvas + (size_t(yPos) * m_bitmapWidthPx + descriptor.imageLeftPos) * 4};
+    if (!frame.graphicControl.hasTransparentColor)
     {
-        if (xPos < viewportWidth && yPos < viewportHeight)
-        {
-            // TODO: Support local color table
-            const uint32_t colorOffset{uint32_t(GIF_AFTER_LOGICAL_SCREEN_DESCRIPTOR_OFFS + decompressedData[i] * 3)};
+        for (uint32_t i{}; i < pixelCount; ++i)
+            std::memcpy(dest + i * 4, &palette[indices[i]], 4);
+        return;
+    }
 
-            uint8_t colorR{m_buffer[colorOffset + 0]};
-            uint8_t colorG{m_buffer[colorOffset + 1]};
-            uint8_t colorB{m_buffer[colorOffset + 2]};
-            Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
+    // The alpha byte of a color in the lookup table
+    const uint32_t alphaMask{toNbo(0xff000000_u32)};
+    for (uint32_t i{}; i < pixelCount; ++i)
+    {
+        const uint32_t color{palette[indices[i]]};
+        // The previous frame shows through the transparent pixels
+        if (color & alphaMask)
+            std::memcpy(dest + i * 4, &color, 4);
+    }
+}
+
+void GifImage::_fillInterlaceGaps(
+        const ImageFrame& frame, uint32_t rowStep,
+        uint8_t* canvas, uint32_t visibleWidth, uint32_t visibleHeight) const
+{
+    const ImageFrame::ImageDescriptor& descriptor{frame.imageDescriptor};
+    if (descriptor.imageLeftPos >= visibleWidth)
+        return;
+
+    const size_t copySize{size_t(std::min<uint32_t>(descriptor.imageWidth, visibleWidth - descriptor.imageLeftPos)) * 4};
+    for (uint32_t rowI{}; rowI < descriptor.imageHeight; ++rowI)
+    {
+        if (rowI % rowStep == 0)
+            continue;
+        const uint32_t yPos{descriptor.imageTopPos + rowI};
+        if (yPos >= visibleHeight)
+            break;
+        const uint32_t sourceYPos{yPos - rowI % rowStep};
+        std::memcpy(
+                canvas + (size_t(yPos) * m_bitmapWidthPx + descriptor.imageLeftPos) * 4,
+                canvas + (size_t(sourceYPos) * m_bitmapWidthPx + descriptor.imageLeftPos) * 4,
+                copySize);
+    }
+}
+
+int GifImage::_drawFrame(
+        const ImageFrame& frame, uint8_t* canvas,
+        uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    LzwDecoder decoder{};
+    // The decoder reads the sub-blocks directly from the file buffer
+    decoder.reset(frame.lzwMinCodeSize, m_buffer + frame.dataOffset, frame.dataSize);
+
+    const ImageFrame::ImageDescriptor& descriptor{frame.imageDescriptor};
+    const uint32_t visibleWidth{std::min(viewportWidth, m_bitmapWidthPx)};
+    const uint32_t visibleHeight{std::min(viewportHeight, m_bitmapHeightPx)};
+
+    // The stored row after the last row of each pass of an interlaced frame
+    uint32_t passEndRowIs[GIF_INTERLACE_PASS_COUNT]{};
+    for (int passI{}; passI < GIF_INTERLACE_PASS_COUNT; ++passI)
+        passEndRowIs[passI] = (passI ? passEndRowIs[passI - 1] : 0) + getInterlacePassRowCount(passI, descriptor.imageHeight);
+    // The gaps can only be filled if the rows of the later passes cover them completely
+    const bool showPasses{m_passCallback && descriptor.isInterlaced && !frame.graphicControl.hasTransparentColor};
+    int passI{};
+
+    // The rows are converted to pixels as soon as they are decoded
+    decoder.decode(descriptor.imageWidth, descriptor.imageHeight,
+            [&](uint32_t rowI, const uint8_t* indices, uint32_t length){
+        if (!descriptor.isInterlaced)
+        {
+            _drawRow(frame, rowI, indices, length, canvas, visibleWidth, visibleHeight);
+            return;
         }
 
-        ++xPos;
-        if (xPos >= m_imageFrames[0]->imageDescriptor.imageWidth)
+        _drawRow(frame, interlacedToImageRowI(rowI, descriptor.imageHeight), indices, length,
+                canvas, visibleWidth, visibleHeight);
+        // Show the finished passes before the last, copying the rows to the rows of the later passes
+        for (; passI < GIF_INTERLACE_PASS_COUNT && rowI + 1 >= passEndRowIs[passI]; ++passI)
         {
-            xPos = 0;
-            ++yPos;
-            if (yPos >= m_bitmapHeightPx)
-                break; // We are done
+            if (!showPasses || passI == GIF_INTERLACE_PASS_COUNT - 1)
+                continue;
+            _fillInterlaceGaps(frame, s_interlacePassRowSteps[passI + 1], canvas, visibleWidth, visibleHeight);
+            m_passCallback(canvas, m_bitmapWidthPx, visibleHeight);
         }
+    });
+
+    return 0;
+}
+
+int GifImage::renderToPixelArray(
+        uint8_t* pixelArray, uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    if (m_imageFrames.empty())
+    {
+        Logger::err << "No image frames to render" << Logger::End;
+        return 1;
     }
 
-    SDL_UnlockTexture(texture);
+    // The pixel array starts transparent, like the canvas of an animation
+    for (uint32_t yPos{}; yPos < std::min(viewportHeight, m_bitmapHeightPx); ++yPos)
+        std::memset(pixelArray + size_t(yPos) * m_bitmapWidthPx * 4, 0, std::min(viewportWidth, m_bitmapWidthPx) * 4);
+
+    return _drawFrame(m_imageFrames[0], pixelArray, viewportWidth, viewportHeight);
+}
+
+uint32_t GifImage::getFrameDelayMs(size_t frameI) const
+{
+    const uint16_t delayCs{m_imageFrames[frameI].graphicControl.delayCs};
+    // Like web browsers, show frames with no or very short delay for the default time
+    if (delayCs < GIF_MIN_FRAME_DELAY_CS)
+        return GIF_DEFAULT_FRAME_DELAY_MS;
+    return delayCs * 10_u32;
+}
+
+SDL_Rect GifImage::getFrameRect(size_t frameI) const
+{
+    const ImageFrame::ImageDescriptor& descriptor{m_imageFrames[frameI].imageDescriptor};
+    if (descriptor.imageLeftPos >= m_bitmapWidthPx || descriptor.imageTopPos >= m_bitmapHeightPx)
+        return SDL_Rect{};
+
+    return SDL_Rect{
+        descriptor.imageLeftPos,
+        descriptor.imageTopPos,
+        (int)std::min<uint32_t>(descriptor.imageWidth, m_bitmapWidthPx - descriptor.imageLeftPos),
+        (int)std::min<uint32_t>(descriptor.imageHeight, m_bitmapHeightPx - descriptor.imageTopPos)};
+}
+
+bool GifImage::isDisposalChangingCanvas(size_t frameI) const
+{
+    const DisposalMethod method{m_imageFrames[frameI].graphicControl.disposalMethod};
+    return method == DisposalMethod::RestoreBackground || method == DisposalMethod::RestorePrevious;
+}
+
+int GifImage::decompressFrame(
+        size_t frameI, LzwDecoder* decoder, uint8_t* indicesOut, uint32_t* rowCountOut) const
+{
+    if (frameI >= m_imageFrames.size())
+    {
+        Logger::err << "Invalid frame index: " << frameI << Logger::End;
+        return 1;
+    }
+
+    const ImageFrame& frame{m_imageFrames[frameI]};
+    decoder->reset(frame.lzwMinCodeSize, m_buffer + frame.dataOffset, frame.dataSize);
+    // Only two pointers are captured, so the callback fits in `std::function` without allocating
+    *rowCountOut = decoder->decode(frame.imageDescriptor.imageWidth, frame.imageDescriptor.imageHeight,
+            [&frame, indicesOut](uint32_t rowI, const uint8_t* indices, uint32_t length){
+        const ImageFrame::ImageDescriptor& descriptor{frame.imageDescriptor};
+        if (descriptor.isInterlaced)
+            rowI = interlacedToImageRowI(rowI, descriptor.imageHeight);
+        std::memcpy(indicesOut + size_t(rowI) * descriptor.imageWidth, indices, length);
+    });
+    return 0;
+}
+
+int GifImage::compositeDecompressedFrame(
+        size_t frameI, const uint8_t* indices, uint32_t rowCount, uint8_t* canvas) const
+{
+    if (frameI >= m_imageFrames.size())
+    {
+        Logger::err << "Invalid frame index: " << frameI << Logger::End;
+        return 1;
+    }
+
+    const ImageFrame& frame{m_imageFrames[frameI]};
+    const uint32_t width{frame.imageDescriptor.imageWidth};
+    for (uint32_t storedRowI{}; storedRowI < rowCount; ++storedRowI)
+    {
+        // The rows of interlaced frames are stored in the order of the passes
+        const uint32_t rowI{frame.imageDescriptor.isInterlaced
+            ? interlacedToImageRowI(storedRowI, frame.imageDescriptor.imageHeight) : storedRowI};
+        _drawRow(frame, rowI, indices + size_t(rowI) * width, width, canvas, m_bitmapWidthPx, m_bitmapHeightPx);
+    }
     return 0;
 }
 
+bool GifImage::needsCanvasBeforeFrame(size_t frameI) const
+{
+    return m_imageFrames[frameI].graphicControl.disposalMethod == DisposalMethod::RestorePrevious;
+}
+
+void GifImage::disposeFrame(size_t frameI, uint8_t* canvas, const uint8_t* canvasBeforeFrame) const
+{
+    const ImageFrame& frame{m_imageFrames[frameI]};
+    const SDL_Rect rect{getFrameRect(frameI)};
+    for (int yPos{rect.y}; yPos < rect.y + rect.h; ++yPos)
+    {
+        const size_t offset{(size_t(yPos) * m_bitmapWidthPx + rect.x) * 4};
+        switch (frame.graphicControl.disposalMethod)
+        {
+        case DisposalMethod::RestoreBackground:
+            // Like web browsers, clear to transparent instead of the background color
+            std::memset(canvas + offset, 0, size_t(rect.w) * 4);
+            break;
+
+        case DisposalMethod::RestorePrevious:
+            std::memcpy(canvas + offset, canvasBeforeFrame + offset, size_t(rect.w) * 4);
+            break;
+
+        default: // Leave the frame in place
+            return;
+        }
+    }
+}
+
 GifImage::~GifImage()
 {
+    delete[] m_buffer;
 }
@@ -26,11 +26,16 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#pragma once
+
 #include "Image.h"
+#include <array>
 #include <filesystem>
 #include <string>
 #include <vector>
 
+class LzwDecoder;
+
 /*
  * This class can open GIF image files.
  *
@@ -48,7 +53,6 @@ public:
     };
 
 private:
-    uint8_t* m_buffer{};
     GifVersion m_gifVersion;
     struct LogicalScreen
     {
@@ -67,8 +71,17 @@ private:
     int m_globalColorTableSizeInColors{};
     int m_globalColorTableSizeInBytes{};
 
+    enum class DisposalMethod
+    {
+        Unspecified,
+        DoNotDispose,       // Leave the frame in place
+        RestoreBackground,  // Clear the area of the frame to the background
+        RestorePrevious,    // Restore what was there before the frame
+    };
+
     struct ImageFrame
     {
+        // Offset of the image descriptor
         uint32_t startOffset{};
         struct ImageDescriptor
         {
@@ -81,18 +94,143 @@ private:
             int localColorTableSizeInColors{};
             int localColorTableSizeInBytes{};
         } imageDescriptor;
+        // From the Graphic Control Extension before the frame
+        struct GraphicControl
+        {
+            uint16_t delayCs{}; // In hundredths of a second
+            DisposalMethod disposalMethod{};
+            bool hasTransparentColor{};
+            uint8_t transparentColorIndex{};
+        } graphicControl;
+        // Offset of the local color table, if there is one
+        uint32_t localColorTableOffset{};
+        // Index of the color lookup table in `m_palettes`
+        uint32_t paletteI{};
+        uint8_t lzwMinCodeSize{};
+        // The data sub-blocks, from the first size byte to the block terminator
+        uint32_t dataOffset{};
+        uint32_t dataSize{};
     };
 
-    std::vector<ImageFrame*> m_imageFrames{};
+    // All the frames, indexed in `open()`
+    std::vector<ImageFrame> m_imageFrames{};
+    // RGBA32 colors of the color indices, in the layout of the pixel array.
+    // The transparent index is mapped to a transparent color.
+    using palette_t = std::array<uint32_t, 256>;
+    // The color lookup tables of the frames, frames with the same color table and transparent index share one
+    std::vector<palette_t> m_palettes{};
+    // The number of pixels in the largest frame
+    size_t m_maxFramePixelCount{};
+    // How many times the animation is played, 0 means forever.
+    // Set from the loop count of the NETSCAPE2.0 application extension, 1 if there is none.
+    uint32_t m_playCount{1};
 
     int _fetchLogicalScreenDescriptor();
-    int _fetchImageDescriptor(uint32_t startOffset);
+    int _fetchImageDescriptor(uint32_t startOffset, ImageFrame* frameOut);
+    /*
+     * Processes the extension block at `startOffset`.
+     * The Graphic Control Extension is stored in `graphicControlOut`.
+     * `endOffsetOut` is set to the offset after the block.
+     */
+    int _fetchExtension(uint32_t startOffset, ImageFrame::GraphicControl* graphicControlOut, uint32_t* endOffsetOut);
+    /*
+     * Returns the offset after the block terminator of the sub-blocks starting at `offset`,
+     * or 0 if the sub-blocks are truncated.
+     */
+    uint32_t _skipSubBlocks(uint32_t offset) const;
+    /*
+     * Builds the color lookup tables of the frames and sets their `paletteI`.
+     */
+    void _buildPalettes();
+    /*
+     * Draws row `rowI` of `frame` over `canvas`, skipping the transparent pixels.
+     */
+    void _drawRow(
+            const ImageFrame& frame,
+            uint32_t rowI, const uint8_t* indices, uint32_t length,
+            uint8_t* canvas, uint32_t visibleWidth, uint32_t visibleHeight) const;
+    /*
+     * Fills the rows of an interlaced frame that are not multiples of `rowStep`
+     * with copies of the row above them that is.
+     */
+    void _fillInterlaceGaps(
+            const ImageFrame& frame, uint32_t rowStep,
+            uint8_t* canvas, uint32_t visibleWidth, uint32_t visibleHeight) const;
+    /*
+     * Draws a frame over the pixels of `canvas`, a pixel array of the size of the logical screen.
+     * Transparent pixels of the frame are skipped.
+     * The passes of an interlaced frame are passed to the pass callback as they are finished.
+     */
+    int _drawFrame(
+            const ImageFrame& frame, uint8_t* canvas,
+            uint32_t viewportWidth, uint32_t viewportHeight) const;
 
 public:
     virtual int open(const std::string &filepath) override;
-    virtual int render(
-            SDL_Texture* texture,
+    virtual int renderToPixelArray(
+            uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const override;
+    // LZW decompression is slow
+    virtual bool isSlowToDecode() const override { return true; }
+
+    inline size_t getFrameCount() const { return m_imageFrames.size(); }
+    inline uint32_t getPlayCount() const { return m_playCount; }
+
+    /*
+     * Returns how long frame `frameI` is shown.
+     */
+    uint32_t getFrameDelayMs(size_t frameI) const;
+
+    inline size_t getMaxFramePixelCount() const { return m_maxFramePixelCount; }
+
+    /*
+     * Decompresses frame `frameI` with `decoder` to color indices, one byte per pixel of the frame.
+     * `indicesOut` must have room for `getMaxFramePixelCount()` indices.
+     * This only reads the file buffer, so frames can be decompressed in parallel.
+     * `rowCountOut` is set to the number of complete rows, which is less than the height of the frame
+     * if its data is truncated.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int decompressFrame(
+            size_t frameI, LzwDecoder* decoder, uint8_t* indicesOut, uint32_t* rowCountOut) const;
+
+    /*
+     * Draws frame `frameI` over `canvas`, an RGBA32 pixel array of the size of the logical screen,
+     * from the indices produced by `decompressFrame()`.
+     * The canvas must contain the previous frame, with its disposal applied.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int compositeDecompressedFrame(
+            size_t frameI, const uint8_t* indices, uint32_t rowCount, uint8_t* canvas) const;
+
+    /*
+     * Returns the rectangle of the logical screen covered by frame `frameI`.
+     * The rectangle is empty if the frame is outside the logical screen.
+     */
+    SDL_Rect getFrameRect(size_t frameI) const;
+
+    /*
+     * Whether the disposal of frame `frameI` changes the canvas.
+     */
+    bool isDisposalChangingCanvas(size_t frameI) const;
+
+    /*
+     * Whether the disposal of frame `frameI` needs the canvas from before the frame.
+     */
+    bool needsCanvasBeforeFrame(size_t frameI) const;
+
+    /*
+     * Applies the disposal method of frame `frameI` to `canvas`, after the frame was shown.
+     * `canvasBeforeFrame` is the canvas before compositing the frame,
+     * only used if `needsCanvasBeforeFrame()` returns true.
+     */
+    void disposeFrame(size_t frameI, uint8_t* canvas, const uint8_t* canvasBeforeFrame) const;
 
     virtual ~GifImage() override;
 };
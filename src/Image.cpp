@@ -27,7 +27,152 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "Image.h"
+#include <algorithm>
+#include <cstring>
+#include <typeinfo>
+
+int Image::render(
+        SDL_Texture* texture, uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    if (!m_isInitialized)
+    {
+        Logger::err << "Cannot draw uninitialized image" << Logger::End;
+        return 1;
+    }
+
+    SDL_Rect lockRect{0, 0, (int)viewportWidth, (int)viewportHeight};
+    uint8_t* pixelArray{};
+    int pitch{};
+    if (SDL_LockTexture(texture, &lockRect, (void**)&pixelArray, &pitch))
+    {
+        Logger::err << "Failed to lock texture: " << SDL_GetError() << Logger::End;
+        return 1;
+    }
+
+    int status{renderToPixelArray(pixelArray, viewportWidth, viewportHeight)};
+
+    SDL_UnlockTexture(texture);
+    return status;
+}
+
+std::shared_ptr<DecodedImage> Image::decode() const
+{
+    if (!m_isInitialized)
+    {
+        Logger::err << "Cannot decode uninitialized image" << Logger::End;
+        return nullptr;
+    }
+
+    auto decoded{std::make_shared<DecodedImage>(m_bitmapWidthPx, m_bitmapHeightPx)};
+    if (renderToPixelArray(decoded->getPixels(), m_bitmapWidthPx, m_bitmapHeightPx))
+        return nullptr;
+    return decoded;
+}
+
+std::shared_ptr<DecodedImage> Image::decodeChangedRows(
+        const Image& previous, const DecodedImage& previousDecoded,
+        uint32_t* renderedRowCountOut) const
+{
+    *renderedRowCountOut = m_bitmapHeightPx;
+
+    uint64_t firstRowOffset{};
+    uint64_t lastRowOffset{};
+    uint64_t rowSize{};
+    if (!m_isInitialized || !previous.m_isInitialized ||
+        typeid(*this) != typeid(previous) ||
+        m_fileSize != previous.m_fileSize ||
+        m_bitmapWidthPx != previousDecoded.getWidthPx() ||
+        m_bitmapHeightPx != previousDecoded.getHeightPx() ||
+        !_getRowByteRange(0, &firstRowOffset, &rowSize) ||
+        !_getRowByteRange(m_bitmapHeightPx - 1, &lastRowOffset, &rowSize))
+        return decode();
+
+    // Bottom-up images start with the last row
+    const uint64_t headerSize{std::min(firstRowOffset, lastRowOffset)};
+    if (headerSize > m_fileSize || std::memcmp(m_buffer, previous.m_buffer, headerSize))
+        return decode();
+
+    auto decoded{std::make_shared<DecodedImage>(m_bitmapWidthPx, m_bitmapHeightPx)};
+    std::memcpy(decoded->getPixels(), previousDecoded.getPixels(), decoded->getSizeInBytes());
+
+    *renderedRowCountOut = 0;
+    for (uint32_t row{}; row < m_bitmapHeightPx; ++row)
+    {
+        uint64_t offset{};
+        _getRowByteRange(row, &offset, &rowSize);
+        if (offset + rowSize > m_fileSize) // Truncated file
+            return decode();
+        if (std::memcmp(m_buffer + offset, previous.m_buffer + offset, rowSize) == 0)
+            continue;
+
+        if (_renderRow(decoded->getPixels() + size_t(row) * decoded->getPitch(), row))
+            return nullptr;
+        ++*renderedRowCountOut;
+    }
+
+    return decoded;
+}
 
 Image::~Image()
 {
 }
+
+void Image::_getThumbnailSize(
+        uint32_t maxWidthPx, uint32_t maxHeightPx,
+        uint32_t* widthOut, uint32_t* heightOut) const
+{
+    const double scale{std::min({1.0,
+            (double)maxWidthPx / m_bitmapWidthPx,
+            (double)maxHeightPx / m_bitmapHeightPx})};
+    *widthOut = std::max(1u, uint32_t(m_bitmapWidthPx * scale));
+    *heightOut = std::max(1u, uint32_t(m_bitmapHeightPx * scale));
+}
+
+std::shared_ptr<DecodedImage> Image::decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const
+{
+    auto decoded{decode()};
+    if (!decoded)
+        return nullptr;
+
+    uint32_t thumbWidth{};
+    uint32_t thumbHeight{};
+    _getThumbnailSize(maxWidthPx, maxHeightPx, &thumbWidth, &thumbHeight);
+    if (thumbWidth == m_bitmapWidthPx && thumbHeight == m_bitmapHeightPx)
+        return decoded;
+
+    auto thumbnail{std::make_shared<DecodedImage>(thumbWidth, thumbHeight)};
+    const uint8_t* srcPixels{decoded->getPixels()};
+    uint8_t* dstPixels{thumbnail->getPixels()};
+
+    // Box filter: every thumbnail pixel is the average of the pixels it covers
+    for (uint32_t dstY{}; dstY < thumbHeight; ++dstY)
+    {
+        const uint32_t srcY1{uint32_t(uint64_t(dstY) * m_bitmapHeightPx / thumbHeight)};
+        const uint32_t srcY2{std::max(srcY1 + 1, uint32_t(uint64_t(dstY + 1) * m_bitmapHeightPx / thumbHeight))};
+        for (uint32_t dstX{}; dstX < thumbWidth; ++dstX)
+        {
+            const uint32_t srcX1{uint32_t(uint64_t(dstX) * m_bitmapWidthPx / thumbWidth)};
+            const uint32_t srcX2{std::max(srcX1 + 1, uint32_t(uint64_t(dstX + 1) * m_bitmapWidthPx / thumbWidth))};
+
+            uint32_t sums[4]{};
+            for (uint32_t srcY{srcY1}; srcY < srcY2; ++srcY)
+            {
+                const uint8_t* srcPixel{srcPixels + (size_t(srcY) * m_bitmapWidthPx + srcX1) * 4};
+                for (uint32_t srcX{srcX1}; srcX < srcX2; ++srcX, srcPixel += 4)
+                {
+                    sums[0] += srcPixel[0];
+                    sums[1] += srcPixel[1];
+                    sums[2] += srcPixel[2];
+                    sums[3] += srcPixel[3];
+                }
+            }
+
+            const uint32_t count{(srcY2 - srcY1) * (srcX2 - srcX1)};
+            uint8_t* dstPixel{dstPixels + (size_t(dstY) * thumbWidth + dstX) * 4};
+            for (int i{}; i < 4; ++i)
+                dstPixel[i] = uint8_t(sums[i] / count);
+        }
+    }
+
+    return thumbnail;
+}
@@ -29,11 +29,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "Logger.h"
+#include "DecodedImage.h"
 #include <string>
+#include <memory>
+#include <functional>
 #include <SDL2/SDL.h>
 
 class Image
 {
+public:
+    using passCallback_t = std::function<void(const uint8_t* pixelArray, uint32_t widthPx, uint32_t heightPx)>;
+
 protected:
     bool m_isInitialized{};
     std::string m_filePath;
@@ -41,6 +47,46 @@ protected:
     uint8_t* m_buffer{};
     uint32_t m_bitmapWidthPx{};
     uint32_t m_bitmapHeightPx{};
+    passCallback_t m_passCallback;
+
+    /*
+     * Calculates the size of the thumbnail of the image.
+     * Images smaller than the maximum size are not upscaled.
+     */
+    void _getThumbnailSize(
+            uint32_t maxWidthPx, uint32_t maxHeightPx,
+            uint32_t* widthOut, uint32_t* heightOut) const;
+
+    /*
+     * Gets where the bytes of row `row` are in the file buffer.
+     * Formats whose rows can be decoded separately override this.
+     *
+     * Returns:
+     *      true, if the format is row-addressable.
+     *      false if the rows cannot be decoded separately.
+     */
+    virtual bool _getRowByteRange(uint32_t row, uint64_t* offsetOut, uint64_t* sizeOut) const
+    {
+        (void)row;
+        (void)offsetOut;
+        (void)sizeOut;
+        return false;
+    }
+
+    /*
+     * Renders row `row` of the image to `rowPixels`, an array of `getWidthPx()` RGBA32 pixels.
+     * Only called if `_getRowByteRange()` returns true.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    virtual int _renderRow(uint8_t* rowPixels, uint32_t row) const
+    {
+        (void)rowPixels;
+        (void)row;
+        return 1;
+    }
 
 public:
     Image() {}
@@ -63,8 +109,91 @@ public:
      */
     virtual int render(
             SDL_Texture* texture,
+            uint32_t viewportWidth, uint32_t viewportHeight) const;
+
+    /*
+     * Renders the image to an array of RGBA32 pixels.
+     * The pixel array must be at least `getWidthPx()` pixels wide.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    virtual int renderToPixelArray(
+            uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const = 0;
 
+    /*
+     * Renders the whole image to a newly allocated surface.
+     *
+     * Returns:
+     *      The decoded image, if succeded.
+     *      nullptr if failed.
+     */
+    std::shared_ptr<DecodedImage> decode() const;
+
+    /*
+     * Renders the whole image, reusing the pixels of `previousDecoded`,
+     * the decoded version of `previous`, an earlier version of the same file.
+     * If the format is row-addressable and the header is unchanged,
+     * only the rows whose bytes differ are rendered.
+     * Otherwise the whole image is rendered.
+     *
+     * Returns:
+     *      The decoded image, if succeded.
+     *      nullptr if failed.
+     */
+    std::shared_ptr<DecodedImage> decodeChangedRows(
+            const Image& previous, const DecodedImage& previousDecoded,
+            uint32_t* renderedRowCountOut) const;
+
+    /*
+     * Renders a downscaled version of the image that fits in
+     * `maxWidthPx` x `maxHeightPx`, keeping the aspect ratio.
+     * By default the whole image is decoded and downscaled,
+     * formats that allow it only decode the sampled pixels.
+     *
+     * Returns:
+     *      The thumbnail, if succeded.
+     *      nullptr if failed.
+     */
+    virtual std::shared_ptr<DecodedImage> decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const;
+
+    /*
+     * Decodes the samples of the image without reducing them to 8 bits,
+     * so its levels can be adjusted later without decoding the file again.
+     *
+     * Returns:
+     *      The samples, if the format supports it and succeded.
+     *      nullptr otherwise.
+     */
+    virtual std::shared_ptr<DecodedWideImage> decodeWide() const { return nullptr; }
+
+    /*
+     * Sets the function called with the pixel array after every pass but the last
+     * while rendering, so the image can be shown before it is complete.
+     * Only formats that render in passes (interlaced GIF) call it,
+     * the rows not rendered yet are filled in with copies of the rendered ones.
+     */
+    inline void setPassCallback(passCallback_t callback) { m_passCallback = std::move(callback); }
+
+    /*
+     * Whether decoding the image takes much longer than just reading its pixels.
+     * These images are worth storing in the disk cache.
+     */
+    virtual bool isSlowToDecode() const { return false; }
+
+    /*
+     * Whether the rows of the image can be decoded separately,
+     * so `decodeChangedRows()` can skip the unchanged ones.
+     */
+    inline bool isRowAddressable() const
+    {
+        uint64_t offset{};
+        uint64_t size{};
+        return m_isInitialized && _getRowByteRange(0, &offset, &size);
+    }
+
     inline const std::string& getFilepath() const { return m_filePath; }
     inline uint32_t getWidthPx() const { return m_bitmapWidthPx; };
     inline uint32_t getHeightPx() const { return m_bitmapHeightPx; };
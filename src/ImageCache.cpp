@@ -0,0 +1,123 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImageCache.h"
+#include "Logger.h"
+#include <sys/stat.h>
+#include <cstring>
+#include <cerrno>
+
+size_t ImageCache::KeyHash::operator()(const Key& key) const
+{
+    size_t hash{std::hash<std::string>{}(key.filePath)};
+    hash ^= std::hash<uint64_t>{}(key.fileSize) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<int64_t>{}(key.modificationTimeNs) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+int ImageCache::makeKey(const std::string& filepath, Key* keyOut)
+{
+    struct stat fileInfo{};
+    if (stat(filepath.c_str(), &fileInfo))
+    {
+        Logger::err << "Failed to stat file: " << std::strerror(errno) << Logger::End;
+        return 1;
+    }
+
+    keyOut->filePath = filepath;
+    keyOut->fileSize = fileInfo.st_size;
+    keyOut->modificationTimeNs = int64_t(fileInfo.st_mtim.tv_sec) * 1000000000 + fileInfo.st_mtim.tv_nsec;
+    return 0;
+}
+
+void ImageCache::_removeEntry(entryList_t::iterator entry)
+{
+    m_usedBytes -= entry->second->getSizeInBytes();
+    m_entryMap.erase(entry->first);
+    m_entries.erase(entry);
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::get(const Key& key)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    auto found{m_entryMap.find(key)};
+    if (found == m_entryMap.end())
+    {
+        ++m_stats.misses;
+        return nullptr;
+    }
+
+    ++m_stats.hits;
+    // Move it to the front, this is the most recently used entry now
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    return found->second->second;
+}
+
+void ImageCache::put(const Key& key, std::shared_ptr<const DecodedImage> image)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    // Drop the entry with the same key and the outdated versions of the file
+    for (auto it{m_entries.begin()}; it != m_entries.end();)
+    {
+        auto next{std::next(it)};
+        if (it->first.filePath == key.filePath)
+            _removeEntry(it);
+        it = next;
+    }
+
+    if (image->getSizeInBytes() > m_budgetBytes)
+        return;
+
+    while (m_usedBytes + image->getSizeInBytes() > m_budgetBytes)
+    {
+        _removeEntry(std::prev(m_entries.end()));
+        ++m_stats.evictions;
+    }
+
+    m_usedBytes += image->getSizeInBytes();
+    m_entries.emplace_front(key, std::move(image));
+    m_entryMap[key] = m_entries.begin();
+}
+
+ImageCache::Stats ImageCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_stats;
+}
+
+void ImageCache::logStats() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    Logger::log << std::dec << "Image cache: " <<
+        m_stats.hits << " hit(s), " <<
+        m_stats.misses << " miss(es), " <<
+        m_stats.evictions << " eviction(s), " <<
+        m_entries.size() << " entries using " << m_usedBytes << '/' << m_budgetBytes << " bytes" << Logger::End;
+}
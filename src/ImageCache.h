@@ -0,0 +1,123 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "DecodedImage.h"
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define IMAGE_CACHE_DEFAULT_BUDGET_MIB 256
+
+/*
+ * An in-memory LRU cache of decoded images.
+ *
+ * The entries are keyed by the path, the size and the modification time of the file,
+ * so a modified file is never served from the cache.
+ * When the size of the cached pixels would exceed the budget, the least recently
+ * used entries are evicted. Evicted images stay alive as long as someone still uses them.
+ *
+ * All methods are thread-safe.
+ */
+class ImageCache final
+{
+public:
+    struct Key
+    {
+        std::string filePath;
+        uint64_t fileSize{};
+        int64_t modificationTimeNs{};
+
+        inline bool operator==(const Key& other) const
+        {
+            return fileSize == other.fileSize &&
+                   modificationTimeNs == other.modificationTimeNs &&
+                   filePath == other.filePath;
+        }
+    };
+
+    struct Stats
+    {
+        uint64_t hits{};
+        uint64_t misses{};
+        uint64_t evictions{};
+    };
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    using entry_t = std::pair<Key, std::shared_ptr<const DecodedImage>>;
+    using entryList_t = std::list<entry_t>;
+
+    size_t m_budgetBytes{};
+    size_t m_usedBytes{};
+    // The most recently used entry is the first one
+    entryList_t m_entries;
+    std::unordered_map<Key, entryList_t::iterator, KeyHash> m_entryMap;
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+
+    void _removeEntry(entryList_t::iterator entry);
+
+public:
+    ImageCache(size_t budgetBytes)
+        : m_budgetBytes{budgetBytes}
+    {
+    }
+
+    /*
+     * Fills `keyOut` using the current state of the file `filepath`.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    static int makeKey(const std::string& filepath, Key* keyOut);
+
+    /*
+     * Returns the cached image or nullptr if it is not in the cache.
+     */
+    std::shared_ptr<const DecodedImage> get(const Key& key);
+
+    /*
+     * Adds an image to the cache, evicting the least recently used entries if needed.
+     * Older versions of the same file are dropped.
+     * Images larger than the whole budget are not cached.
+     */
+    void put(const Key& key, std::shared_ptr<const DecodedImage> image);
+
+    Stats getStats() const;
+    void logStats() const;
+};
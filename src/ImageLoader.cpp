@@ -0,0 +1,246 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImageLoader.h"
+#include "BmpImage.h"
+#include "PnmImage.h"
+#include "GifImage.h"
+#include "SvgImage.h"
+#include "PnmStream.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+
+static std::string getLowercaseExtension(const std::string& filepath)
+{
+    std::string fileExtension{filepath.substr(filepath.find_last_of('.')+1)};
+    std::transform(
+            fileExtension.begin(), fileExtension.end(),
+            fileExtension.begin(),
+            [](char c){ return std::tolower(c); });
+    return fileExtension;
+}
+
+static bool isPnmExtension(const std::string& fileExtension)
+{
+    return fileExtension.compare("pnm") == 0 ||
+           fileExtension.compare("pbm") == 0 ||
+           fileExtension.compare("pgm") == 0 ||
+           fileExtension.compare("ppm") == 0 ||
+           fileExtension.compare("pam") == 0;
+}
+
+bool isSupportedImageFile(const std::string& filepath)
+{
+    if (filepath.find_last_of('.') == std::string::npos)
+        return false;
+
+    const std::string fileExtension{getLowercaseExtension(filepath)};
+    return fileExtension.compare("bmp") == 0 ||
+           isPnmExtension(fileExtension) ||
+           fileExtension.compare("gif") == 0 ||
+           fileExtension.compare("svg") == 0;
+}
+
+std::vector<std::string> listImageFilesInDirectory(const std::string& dirPath)
+{
+    std::vector<std::string> filePaths;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator{dirPath, error})
+    {
+        if (file.is_regular_file(error) && isSupportedImageFile(file.path().string()))
+            filePaths.push_back(file.path().string());
+    }
+    if (error)
+        Logger::err << "Failed to list directory: " << dirPath << ": " << error.message() << Logger::End;
+
+    std::sort(filePaths.begin(), filePaths.end());
+    return filePaths;
+}
+
+std::vector<std::string> listImageSequence(const std::string& filepath)
+{
+    const std::filesystem::path path{filepath};
+    const std::string fileName{path.filename().string()};
+
+    // The frame number is the last run of digits before the extension
+    const size_t extensionStart{std::min(fileName.find_last_of('.'), fileName.size())};
+    size_t numberStart{extensionStart};
+    while (numberStart > 0 && std::isdigit((unsigned char)fileName[numberStart - 1]))
+        --numberStart;
+    if (numberStart == extensionStart)
+        return {};
+    const std::string prefix{fileName.substr(0, numberStart)};
+
+    std::vector<std::pair<unsigned long long, std::string>> frames;
+    std::error_code error;
+    const std::filesystem::path dirPath{path.has_parent_path() ? path.parent_path() : "."};
+    for (const auto& file : std::filesystem::directory_iterator{dirPath, error})
+    {
+        const std::string otherName{file.path().filename().string()};
+        const size_t otherExtensionStart{otherName.find_last_of('.')};
+        if (otherExtensionStart == std::string::npos || otherExtensionStart <= prefix.size() ||
+            otherName.compare(0, prefix.size(), prefix) != 0 ||
+            !std::all_of(otherName.begin() + prefix.size(), otherName.begin() + otherExtensionStart,
+                [](char c){ return std::isdigit((unsigned char)c); }) ||
+            !file.is_regular_file(error) || !isSupportedImageFile(otherName))
+            continue;
+
+        frames.emplace_back(
+                std::strtoull(otherName.c_str() + prefix.size(), nullptr, 10),
+                (path.has_parent_path() ? file.path() : file.path().filename()).string());
+    }
+    if (error)
+        Logger::err << "Failed to list directory: " << dirPath.string() << ": " << error.message() << Logger::End;
+
+    std::sort(frames.begin(), frames.end());
+    std::vector<std::string> framePaths;
+    for (auto& frame : frames)
+        framePaths.push_back(std::move(frame.second));
+    return framePaths;
+}
+
+std::unique_ptr<Image> createImageForFile(const std::string& filepath)
+{
+    // Streams can be read only once, they are played by PnmStream
+    if (PnmStream::isStreamPath(filepath))
+    {
+        Logger::err << "Cannot open stream as an image file: " << filepath << Logger::End;
+        return nullptr;
+    }
+
+    const std::string fileExtension{getLowercaseExtension(filepath)};
+
+    if (fileExtension.compare("bmp") == 0)
+    {
+        return std::make_unique<BmpImage>();
+    }
+    else if (isPnmExtension(fileExtension))
+    {
+        return std::make_unique<PnmImage>();
+    }
+    else if (fileExtension.compare("gif") == 0)
+    {
+        return std::make_unique<GifImage>();
+    }
+    else if (fileExtension.compare("svg") == 0)
+    {
+        return std::make_unique<SvgImage>();
+    }
+
+    Logger::err << "Unknown file extension: " << fileExtension << Logger::End;
+    return nullptr;
+}
+
+std::unique_ptr<GifAnimation> createAnimationForFile(const std::string& filepath)
+{
+    if (getLowercaseExtension(filepath).compare("gif") != 0 || PnmStream::isStreamPath(filepath))
+        return nullptr;
+
+    auto animation{std::make_unique<GifAnimation>()};
+    if (animation->open(filepath) || !animation->isAnimated())
+        return nullptr;
+    return animation;
+}
+
+std::shared_ptr<const DecodedWideImage> loadWideImage(const std::string& filepath)
+{
+    // Only PNM images have more than 8 bits per sample
+    if (!isPnmExtension(getLowercaseExtension(filepath)) || PnmStream::isStreamPath(filepath))
+        return nullptr;
+
+    auto image{createImageForFile(filepath)};
+    if (!image || image->open(filepath))
+        return nullptr;
+    return image->decodeWide();
+}
+
+std::shared_ptr<const DecodedImage> loadImage(
+        const std::string& filepath, ImageCache* cache, DiskCache* diskCache,
+        const Image::passCallback_t& passCallback, std::unique_ptr<Image>* openedImageOut)
+{
+    ImageCache::Key cacheKey{};
+    if (cache || diskCache)
+    {
+        if (ImageCache::makeKey(filepath, &cacheKey))
+            return nullptr;
+    }
+
+    if (cache)
+    {
+        auto cached{cache->get(cacheKey)};
+        if (cached)
+        {
+            Logger::log << "Image found in cache: " << filepath << Logger::End;
+            return cached;
+        }
+    }
+
+    if (diskCache)
+    {
+        std::shared_ptr<const DecodedImage> cached{diskCache->get(cacheKey)};
+        if (cached)
+        {
+            Logger::log << "Image found in disk cache: " << filepath << Logger::End;
+            if (cache)
+                cache->put(cacheKey, cached);
+            return cached;
+        }
+    }
+
+    auto image{createImageForFile(filepath)};
+    if (!image)
+        return nullptr;
+
+    if (image->open(filepath))
+    {
+        Logger::err << "Failed to open image: " << filepath << Logger::End;
+        return nullptr;
+    }
+
+    image->setPassCallback(passCallback);
+    std::shared_ptr<const DecodedImage> decoded{image->decode()};
+    if (!decoded)
+    {
+        Logger::err << "Failed to decode image: " << filepath << Logger::End;
+        return nullptr;
+    }
+
+    if (diskCache && image->isSlowToDecode())
+        diskCache->putAsync(cacheKey, decoded);
+    if (cache)
+        cache->put(cacheKey, decoded);
+    if (openedImageOut)
+    {
+        image->setPassCallback({});
+        *openedImageOut = std::move(image);
+    }
+    return decoded;
+}
@@ -0,0 +1,105 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "Image.h"
+#include "DecodedImage.h"
+#include "ImageCache.h"
+#include "DiskCache.h"
+#include "GifAnimation.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Returns true if the extension of the file is one of the supported image formats.
+ */
+bool isSupportedImageFile(const std::string& filepath);
+
+/*
+ * Collects the supported image files in the directory, sorted by name.
+ */
+std::vector<std::string> listImageFilesInDirectory(const std::string& dirPath);
+
+/*
+ * Collects the frames of the numbered image sequence `filepath` belongs to, like
+ * `frame_00001.ppm`, `frame_00002.bmp`, etc.: the supported image files in its directory
+ * whose names only differ in the last number and in the extension, sorted by the number.
+ *
+ * Returns:
+ *      The paths of the frames, including `filepath`.
+ *      An empty list if the file name has no number.
+ */
+std::vector<std::string> listImageSequence(const std::string& filepath);
+
+/*
+ * Creates an image object of the right type for the file based on its extension.
+ *
+ * Returns:
+ *      The image object, if succeded.
+ *      nullptr if the extension is unknown.
+ */
+std::unique_ptr<Image> createImageForFile(const std::string& filepath);
+
+/*
+ * Opens the file as an animation, if its format supports animation.
+ *
+ * Returns:
+ *      The animation, if the file is animated.
+ *      nullptr if the file is not animated or failed to open.
+ */
+std::unique_ptr<GifAnimation> createAnimationForFile(const std::string& filepath);
+
+/*
+ * Opens the image file `filepath` and decodes its samples at full depth.
+ * The decoded image is not cached, the levels can be adjusted on it instead of reloading it.
+ *
+ * Returns:
+ *      The samples, if the format keeps them and succeded.
+ *      nullptr if the format doesn't keep them or failed.
+ */
+std::shared_ptr<const DecodedWideImage> loadWideImage(const std::string& filepath);
+
+/*
+ * Opens and decodes the image file `filepath`.
+ * If `cache` is not null, the image is looked up in it first and
+ * added to it after decoding.
+ * If `diskCache` is not null, it is checked before decoding, and
+ * images that are slow to decode are stored in it in the background.
+ * `passCallback` is called with the partially decoded pixels by formats that decode in passes.
+ * If `openedImageOut` is not null and the file had to be decoded, the opened image is moved to it,
+ * so the bytes the pixels were decoded from can be compared with a later version of the file.
+ *
+ * Returns:
+ *      The decoded image, if succeded.
+ *      nullptr if failed.
+ */
+std::shared_ptr<const DecodedImage> loadImage(
+        const std::string& filepath, ImageCache* cache, DiskCache* diskCache,
+        const Image::passCallback_t& passCallback={}, std::unique_ptr<Image>* openedImageOut=nullptr);
@@ -0,0 +1,221 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImageSequence.h"
+#include "ImageLoader.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+ImageSequence::ImageSequence(std::vector<std::string> framePaths, size_t startFrameI, double targetFps)
+    : m_framePaths{std::move(framePaths)}, m_startFrameI{startFrameI}, m_targetFps{targetFps},
+    m_ring(IMAGE_SEQUENCE_RING_SIZE)
+{
+    Logger::log << "Playing image sequence of " << m_framePaths.size() << " frames at " <<
+        m_targetFps << " FPS" << Logger::End;
+
+    m_decodePool = std::make_unique<ThreadPool>();
+    m_playStart = std::chrono::steady_clock::now();
+    m_ratePeriodStart = m_playStart;
+    std::lock_guard<std::mutex> lock{m_mutex};
+    _scheduleDecodes(0);
+}
+
+void ImageSequence::_decodeFrame(uint64_t tick)
+{
+    const std::string& framePath{m_framePaths[(m_startFrameI + tick) % m_framePaths.size()]};
+    std::shared_ptr<DecodedImage> pixels;
+    auto image{createImageForFile(framePath)};
+    if (image && !image->open(framePath))
+    {
+        pixels = m_surfacePool.get(image->getWidthPx(), image->getHeightPx());
+        // The decoders skip the pixels missing from broken files, they must not show an earlier frame
+        std::memset(pixels->getPixels(), 0, pixels->getSizeInBytes());
+        if (image->renderToPixelArray(pixels->getPixels(), image->getWidthPx(), image->getHeightPx()))
+            pixels.reset();
+    }
+    if (!pixels)
+        Logger::warn << "Failed to decode frame of image sequence: " << framePath << Logger::End;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    Slot& slot{m_ring[tick % IMAGE_SEQUENCE_RING_SIZE]};
+    if (slot.isCancelled)
+    {
+        slot.isCancelled = false;
+        slot.state = SlotState::Free;
+        return;
+    }
+
+    if (pixels)
+    {
+        slot.pixels = std::move(pixels);
+        slot.state = SlotState::Ready;
+        ++m_stats.decodedFrames;
+    }
+    else
+    {
+        slot.state = SlotState::Failed;
+        ++m_stats.failedFrames;
+    }
+}
+
+uint64_t ImageSequence::_getDueTick(std::chrono::steady_clock::time_point now) const
+{
+    const double elapsedS{std::chrono::duration<double>(now - m_playStart).count()};
+    return uint64_t(std::max(0.0, std::floor(elapsedS * m_targetFps)));
+}
+
+void ImageSequence::_scheduleDecodes(uint64_t dueTick)
+{
+    // The frames that would be late are not decoded at all
+    if (m_nextDecodeTick < dueTick)
+    {
+        m_stats.droppedFrames += dueTick - m_nextDecodeTick;
+        m_nextDecodeTick = dueTick;
+    }
+
+    // The ring holds the frames from the next one to show
+    const uint64_t windowStart{std::max(uint64_t(m_shownTick + 1), dueTick)};
+    while (m_nextDecodeTick < windowStart + IMAGE_SEQUENCE_RING_SIZE)
+    {
+        Slot& slot{m_ring[m_nextDecodeTick % IMAGE_SEQUENCE_RING_SIZE]};
+        // Still decoding a dropped frame
+        if (slot.state != SlotState::Free)
+            break;
+
+        slot.tick = m_nextDecodeTick;
+        slot.state = SlotState::Decoding;
+        m_decodePool->post([this, tick{m_nextDecodeTick}](){ _decodeFrame(tick); });
+        ++m_nextDecodeTick;
+    }
+}
+
+std::shared_ptr<const DecodedImage> ImageSequence::takeFrameToShow()
+{
+    const uint64_t dueTick{_getDueTick(std::chrono::steady_clock::now())};
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    // Find the newest finished frame that is due
+    int64_t newTick{-1};
+    for (const Slot& slot : m_ring)
+    {
+        if ((slot.state == SlotState::Ready || slot.state == SlotState::Failed) &&
+            int64_t(slot.tick) > m_shownTick && slot.tick <= dueTick)
+            newTick = std::max(newTick, int64_t(slot.tick));
+    }
+    if (newTick == -1)
+    {
+        _scheduleDecodes(dueTick);
+        return nullptr;
+    }
+
+    // Drop the frames before it
+    for (Slot& slot : m_ring)
+    {
+        if (slot.tick >= uint64_t(newTick) || slot.isCancelled)
+            continue;
+        switch (slot.state)
+        {
+        case SlotState::Ready:
+            ++m_stats.droppedFrames;
+            slot.pixels.reset();
+            slot.state = SlotState::Free;
+            break;
+
+        case SlotState::Decoding:
+            ++m_stats.droppedFrames;
+            slot.isCancelled = true;
+            break;
+
+        case SlotState::Failed:
+            slot.state = SlotState::Free;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // A frame that failed to decode is skipped, the previous one stays
+    Slot& slot{m_ring[newTick % IMAGE_SEQUENCE_RING_SIZE]};
+    std::shared_ptr<const DecodedImage> frame{std::move(slot.pixels)};
+    slot.state = SlotState::Free;
+    if (frame)
+        ++m_stats.shownFrames;
+    m_shownTick = newTick;
+
+    _scheduleDecodes(dueTick);
+    return frame;
+}
+
+int ImageSequence::getMsUntilNextFrame() const
+{
+    const auto nextFrameDeadline{m_playStart + std::chrono::duration<double>((m_shownTick + 1) / m_targetFps)};
+    const auto untilNextFrame{std::chrono::duration_cast<std::chrono::milliseconds>(
+            nextFrameDeadline - std::chrono::steady_clock::now())};
+    // The next frame is late, wait for the decoders
+    if (untilNextFrame.count() <= 0)
+        return IMAGE_SEQUENCE_UNDERRUN_WAIT_MS;
+    return int(untilNextFrame.count());
+}
+
+bool ImageSequence::updateRates()
+{
+    const auto now{std::chrono::steady_clock::now()};
+    const double periodS{std::chrono::duration<double>(now - m_ratePeriodStart).count()};
+    if (periodS * 1000 < IMAGE_SEQUENCE_RATE_PERIOD_MS)
+        return false;
+
+    const Stats stats{getStats()};
+    m_decodeFps = (stats.decodedFrames - m_ratePeriodStartStats.decodedFrames) / periodS;
+    m_displayFps = (stats.shownFrames - m_ratePeriodStartStats.shownFrames) / periodS;
+    m_ratePeriodStart = now;
+    m_ratePeriodStartStats = stats;
+    return true;
+}
+
+ImageSequence::Stats ImageSequence::getStats()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_stats;
+}
+
+void ImageSequence::logStats()
+{
+    const Stats stats{getStats()};
+    Logger::log << "Image sequence: " << stats.decodedFrames << " frames decoded, " <<
+        stats.shownFrames << " shown, " << stats.droppedFrames << " dropped, " <<
+        stats.failedFrames << " failed" << Logger::End;
+}
+
+ImageSequence::~ImageSequence()
+{
+    // Wait for the running decodes, they use the ring
+    m_decodePool.reset();
+}
@@ -0,0 +1,159 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "DecodedImage.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define IMAGE_SEQUENCE_DEFAULT_FPS      24
+// Number of frames decoded ahead of the shown one
+#define IMAGE_SEQUENCE_RING_SIZE        8
+// How often to check for the next frame when the decoders are late
+#define IMAGE_SEQUENCE_UNDERRUN_WAIT_MS 2
+// The achieved frame rates are measured over periods this long
+#define IMAGE_SEQUENCE_RATE_PERIOD_MS   1000
+
+/*
+ * Plays a numbered series of image files as a video, looping.
+ *
+ * The frames are decoded ahead on a thread pool into a fixed ring of slots,
+ * by the same decoders that open the files as images.
+ * The frames are due at a fixed rate from the start of the playback.
+ * When the decoding can't keep up, the newest decoded frame that is due is shown,
+ * the older ones are dropped, and the frames that would be late are not decoded at all.
+ */
+class ImageSequence final
+{
+public:
+    struct Stats
+    {
+        uint64_t decodedFrames{};
+        uint64_t shownFrames{};
+        // Frames skipped to keep up with the frame rate, decoded or not
+        uint64_t droppedFrames{};
+        uint64_t failedFrames{};
+    };
+
+private:
+    enum class SlotState
+    {
+        Free,
+        Decoding,
+        Ready,
+        Failed,
+    };
+
+    struct Slot
+    {
+        // The position of the frame in the playback: the number of frames played before it
+        uint64_t tick{};
+        SlotState state{};
+        // Set if the frame was dropped while it was being decoded
+        bool isCancelled{};
+        std::shared_ptr<DecodedImage> pixels;
+    };
+
+    std::vector<std::string> m_framePaths;
+    // The frame of the first tick
+    size_t m_startFrameI{};
+    double m_targetFps{};
+    DecodedImagePool m_surfacePool{IMAGE_SEQUENCE_RING_SIZE};
+
+    std::mutex m_mutex;
+    // Slot `tick % IMAGE_SEQUENCE_RING_SIZE` holds the frame of `tick`, protected by `m_mutex`
+    std::vector<Slot> m_ring;
+    // Protected by `m_mutex`
+    Stats m_stats;
+
+    // Used only by the main thread
+    std::chrono::steady_clock::time_point m_playStart;
+    // The tick of the shown frame, -1 before the first one
+    int64_t m_shownTick{-1};
+    // The next tick to decode
+    uint64_t m_nextDecodeTick{};
+    std::chrono::steady_clock::time_point m_ratePeriodStart;
+    Stats m_ratePeriodStartStats;
+    double m_decodeFps{};
+    double m_displayFps{};
+
+    std::unique_ptr<ThreadPool> m_decodePool;
+
+    void _decodeFrame(uint64_t tick);
+    uint64_t _getDueTick(std::chrono::steady_clock::time_point now) const;
+    /*
+     * Starts decoding the frames after the shown one that fit in the ring.
+     * The lock of `m_mutex` must be held.
+     */
+    void _scheduleDecodes(uint64_t dueTick);
+
+public:
+    /*
+     * Starts decoding the frames from frame `startFrameI` of `framePaths`.
+     */
+    ImageSequence(std::vector<std::string> framePaths, size_t startFrameI, double targetFps);
+
+    ImageSequence(const ImageSequence&) = delete;
+    ImageSequence& operator=(const ImageSequence&) = delete;
+
+    /*
+     * Returns the newest decoded frame that is due, dropping the older ones,
+     * or nullptr if there is no new frame to show.
+     */
+    std::shared_ptr<const DecodedImage> takeFrameToShow();
+
+    /*
+     * Returns the time until the next frame should be shown.
+     */
+    int getMsUntilNextFrame() const;
+
+    /*
+     * Measures the achieved frame rates.
+     * Returns true if a measuring period ended and the rates changed.
+     */
+    bool updateRates();
+    inline double getDecodeFps() const { return m_decodeFps; }
+    inline double getDisplayFps() const { return m_displayFps; }
+    inline double getTargetFps() const { return m_targetFps; }
+
+    inline size_t getFrameCount() const { return m_framePaths.size(); }
+    inline size_t getShownFrameI() const
+    {
+        return (m_startFrameI + uint64_t(std::max(m_shownTick, int64_t(0)))) % m_framePaths.size();
+    }
+
+    Stats getStats();
+    void logStats();
+
+    ~ImageSequence();
+};
@@ -0,0 +1,205 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "LiveReloader.h"
+#include "ImageLoader.h"
+#include "Logger.h"
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+int LiveReloader::init()
+{
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd == -1)
+    {
+        Logger::err << "Failed to initialize inotify: " << strerror(errno) << Logger::End;
+        return 1;
+    }
+
+    m_isRunning = true;
+    m_thread = std::thread{&LiveReloader::_threadLoop, this};
+    return 0;
+}
+
+void LiveReloader::watch(const std::string& filePath,
+        std::unique_ptr<Image> image, std::shared_ptr<const DecodedImage> decoded)
+{
+    if (m_inotifyFd == -1)
+        return;
+
+    // Other formats are decoded whole anyway, don't keep their file buffers
+    if (!image || !decoded || !image->isRowAddressable())
+    {
+        image.reset();
+        decoded.reset();
+    }
+
+    std::string dirPath{std::filesystem::path{filePath}.parent_path().string()};
+    if (dirPath.empty())
+        dirPath = ".";
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    // Watching the same directory again returns the same descriptor
+    const int watchDescriptor{inotify_add_watch(m_inotifyFd, dirPath.c_str(),
+            IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)};
+    if (watchDescriptor == -1)
+        Logger::warn << "Failed to watch directory: " << dirPath << ": " << strerror(errno) << Logger::End;
+    if (m_watchDescriptor != -1 && m_watchDescriptor != watchDescriptor)
+        inotify_rm_watch(m_inotifyFd, m_watchDescriptor);
+
+    m_watchDescriptor = watchDescriptor;
+    m_filePath = filePath;
+    ++m_watchGeneration;
+    m_reloadedImage.reset();
+    m_watchedImage = std::move(image);
+    m_watchedDecoded = std::move(decoded);
+}
+
+void LiveReloader::_threadLoop()
+{
+    bool isReloadPending{};
+    auto lastChangeTime{std::chrono::steady_clock::now()};
+    alignas(inotify_event) char buffer[4096];
+
+    while (m_isRunning)
+    {
+        int timeoutMs{LIVE_RELOAD_POLL_PERIOD_MS};
+        if (isReloadPending)
+        {
+            const auto sinceLastChange{std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - lastChangeTime).count()};
+            timeoutMs = std::max(0, std::min(timeoutMs, int(LIVE_RELOAD_DEBOUNCE_MS - sinceLastChange)));
+        }
+
+        pollfd pollFd{m_inotifyFd, POLLIN, 0};
+        if (poll(&pollFd, 1, timeoutMs) > 0)
+        {
+            std::string fileName;
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                fileName = std::filesystem::path{m_filePath}.filename().string();
+            }
+
+            ssize_t readSize{};
+            while ((readSize = read(m_inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (ssize_t offset{}; offset < readSize;)
+                {
+                    const inotify_event* event{(const inotify_event*)(buffer + offset)};
+                    if (event->len && fileName == event->name)
+                    {
+                        isReloadPending = true;
+                        lastChangeTime = std::chrono::steady_clock::now();
+                    }
+                    offset += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+
+        if (isReloadPending && std::chrono::steady_clock::now() - lastChangeTime
+                >= std::chrono::milliseconds{LIVE_RELOAD_DEBOUNCE_MS})
+        {
+            isReloadPending = false;
+            _reload();
+        }
+    }
+}
+
+void LiveReloader::_reload()
+{
+    std::string filePath;
+    uint64_t generation{};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        filePath = m_filePath;
+        generation = m_watchGeneration;
+
+        // The previous version belongs to another file, start from the one opened by `watch()`
+        if (generation != m_previousGeneration)
+        {
+            m_previousImage = std::move(m_watchedImage);
+            m_previousDecoded = std::move(m_watchedDecoded);
+        }
+    }
+
+    Logger::log << "File changed, reloading: " << filePath << Logger::End;
+    auto image{createImageForFile(filePath)};
+    if (!image || image->open(filePath))
+    {
+        // Probably still being written, the next change triggers a reload again
+        Logger::warn << "Failed to reload image, keeping the current one" << Logger::End;
+        return;
+    }
+
+    std::shared_ptr<DecodedImage> decoded;
+    uint32_t renderedRowCount{};
+    if (m_previousImage)
+    {
+        decoded = image->decodeChangedRows(*m_previousImage, *m_previousDecoded, &renderedRowCount);
+    }
+    else
+    {
+        decoded = image->decode();
+        renderedRowCount = image->getHeightPx();
+    }
+    if (!decoded)
+    {
+        Logger::warn << "Failed to reload image, keeping the current one" << Logger::End;
+        return;
+    }
+    Logger::log << std::dec << "Reloaded image, rendered " << renderedRowCount << '/' <<
+        image->getHeightPx() << " rows" << Logger::End;
+
+    m_previousImage = std::move(image);
+    m_previousDecoded = decoded;
+    m_previousGeneration = generation;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (generation == m_watchGeneration)
+        m_reloadedImage = std::move(decoded);
+}
+
+std::shared_ptr<const DecodedImage> LiveReloader::takeReloadedImage()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return std::move(m_reloadedImage);
+}
+
+LiveReloader::~LiveReloader()
+{
+    m_isRunning = false;
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_inotifyFd != -1)
+        close(m_inotifyFd);
+}
@@ -0,0 +1,110 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include "Image.h"
+#include "DecodedImage.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Wait this long after the last change, so the writer can finish writing the file
+#define LIVE_RELOAD_DEBOUNCE_MS     150
+// How often the watcher thread checks if it should stop
+#define LIVE_RELOAD_POLL_PERIOD_MS  100
+
+/*
+ * Watches the shown image file with inotify and decodes it again in the background when it changes.
+ *
+ * The directory of the file is watched, so files replaced by renaming are also noticed.
+ * Files rewritten in place keep the unchanged rows: the new file contents are
+ * compared with the previous ones and only the changed rows are rendered, if the format allows it.
+ * The file is read to a buffer, not mapped, because a mapping would change with the file.
+ */
+class LiveReloader final
+{
+private:
+    int m_inotifyFd{-1};
+    int m_watchDescriptor{-1};
+    std::thread m_thread;
+    std::atomic<bool> m_isRunning{};
+
+    std::mutex m_mutex;
+    // The watched file, protected by `m_mutex`
+    std::string m_filePath;
+    // Incremented when the watched file changes, so reloads of the old file are dropped
+    uint64_t m_watchGeneration{};
+    // The newest reloaded image, not taken yet, protected by `m_mutex`
+    std::shared_ptr<const DecodedImage> m_reloadedImage;
+    // The version of the file given to `watch()` and its decoded image,
+    // taken by the first reload, protected by `m_mutex`
+    std::unique_ptr<Image> m_watchedImage;
+    std::shared_ptr<const DecodedImage> m_watchedDecoded;
+
+    // The last reloaded version of the file, used only by the watcher thread
+    std::unique_ptr<Image> m_previousImage;
+    std::shared_ptr<const DecodedImage> m_previousDecoded;
+    uint64_t m_previousGeneration{};
+
+    void _threadLoop();
+    void _reload();
+
+public:
+    LiveReloader() {}
+
+    LiveReloader(const LiveReloader&) = delete;
+    LiveReloader& operator=(const LiveReloader&) = delete;
+
+    /*
+     * Starts the watcher thread.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int init();
+
+    /*
+     * Starts watching `filePath` instead of the previous file.
+     * `image` is the opened file the shown pixels `decoded` were decoded from, or nullptr.
+     * If both are given and the rows of the image can be decoded separately,
+     * they are kept, so the first reload can render only the changed rows.
+     */
+    void watch(const std::string& filePath,
+            std::unique_ptr<Image> image, std::shared_ptr<const DecodedImage> decoded);
+
+    /*
+     * Returns the image decoded after the last change of the file,
+     * or nullptr if there is no new one since the last call.
+     */
+    std::shared_ptr<const DecodedImage> takeReloadedImage();
+
+    ~LiveReloader();
+};
@@ -3,6 +3,8 @@
 namespace Logger
 {
 
+std::mutex outputMutex;
+
 Logger log{Logger::Type::Log};
 Logger warn{Logger::Type::Warning};
 Logger err{Logger::Type::Error};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <mutex>
+#include <sstream>
 
 #define LOGGER_USE_COLORS 1
 
@@ -20,6 +22,27 @@ enum Control
     End, // Can be used to mark the end of the line
 };
 
+/*
+ * Lines are built in a buffer of the calling thread, then written at once,
+ * so the lines of different threads don't interleave.
+ * The format flags (like `std::hex`) are kept per thread, between the lines too.
+ */
+struct LineBuffer
+{
+    std::ostringstream stream;
+    // Whether this is the beginning of the line
+    bool isBeginning{true};
+};
+
+inline LineBuffer& getLineBuffer()
+{
+    static thread_local LineBuffer buffer;
+    return buffer;
+}
+
+// Held while a finished line is written, shared by every logger
+extern std::mutex outputMutex;
+
 class Logger final
 {
 public:
@@ -34,8 +57,6 @@ public:
     };
 
 private:
-    // Whether this is the beginning of the line
-    bool m_isBeginning{true};
     // The logger type: info, error, etc.
     Type m_type{};
 
@@ -48,41 +69,54 @@ public:
     template <typename T>
     Logger& operator<<(const T &value)
     {
+        LineBuffer& buffer{getLineBuffer()};
+
         // If this is the beginning of the line, print the "initial"
         // depending on the logger type
-        if (m_isBeginning)
+        if (buffer.isBeginning)
         {
             switch (m_type)
             {
             case Type::Log:
 #ifdef LOGGER_USE_COLORS
-                std::cout << LOGGER_COLOR_LOG << "[INFO]: " << LOGGER_COLOR_RESET;
+                buffer.stream << LOGGER_COLOR_LOG << "[INFO]: " << LOGGER_COLOR_RESET;
 #else
-                std::cout << "[INFO]: ";
+                buffer.stream << "[INFO]: ";
 #endif
                 break;
 
             case Type::Warning:
 #ifdef LOGGER_USE_COLORS
-                std::cout << LOGGER_COLOR_WARN << "[WARN]: " << LOGGER_COLOR_RESET;
+                buffer.stream << LOGGER_COLOR_WARN << "[WARN]: " << LOGGER_COLOR_RESET;
 #else
-                std::cout << "[WARN]: ";
+                buffer.stream << "[WARN]: ";
 #endif
                 break;
 
             case Type::Error:
 #ifdef LOGGER_USE_COLORS
-                std::cout << LOGGER_COLOR_ERR << "[ERR]: " << LOGGER_COLOR_RESET;
+                buffer.stream << LOGGER_COLOR_ERR << "[ERR]: " << LOGGER_COLOR_RESET;
 #else
-                std::cout << "[ERR]: ";
+                buffer.stream << "[ERR]: ";
 #endif
                 break;
             }
 
             // This is not the beginning of the line anymore
-            m_isBeginning = false;
+            buffer.isBeginning = false;
         }
-        std::cout << value;
+        buffer.stream << value;
+
+        // Make the operator chainable
+        return *this;
+    }
+
+    /*
+     * Manipulators (like `std::hex`) only change the format, they don't start a line.
+     */
+    Logger& operator<<(std::ios_base& (*manipulator)(std::ios_base&))
+    {
+        getLineBuffer().stream << manipulator;
 
         // Make the operator chainable
         return *this;
@@ -92,9 +126,15 @@ public:
     {
         if (ctrl == End)
         {
-            std::cout << "\n";
-            // We printed the \n, to this is the beginning of the new line
-            m_isBeginning = true;
+            LineBuffer& buffer{getLineBuffer()};
+            buffer.stream << '\n';
+            {
+                std::lock_guard<std::mutex> lock{outputMutex};
+                std::cout << buffer.stream.str();
+            }
+            // Start the new line, keeping the format flags
+            buffer.stream.str({});
+            buffer.isBeginning = true;
         }
 
         // Make the operator chainable
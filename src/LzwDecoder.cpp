@@ -29,7 +29,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "LzwDecoder.h"
 #include "bitmagic.h"
 #include "Logger.h"
-#include <unordered_map>
 #include <iostream>
 #include <ctime>
 #include <string>
@@ -37,145 +36,161 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cstring>
 #include <bitset>
 
-std::vector<uint8_t> LzwDecoder::getDecompressedData()
+uint32_t LzwDecoder::decode(uint32_t rowLength, uint32_t rowCount, const rowCallback_t& rowCallback)
 {
-    Logger::log << "Decompressor: Starting decompression of 0x" << m_inputBuffer.size() << " bytes" << Logger::End;
+    Logger::log << "Decompressor: Starting decompression" << Logger::End;
     Logger::log << "Decompressor: Code size: " << +m_initialCodeSize << Logger::End;
 
-    /*
+    // Literal codes are bytes
     if (m_initialCodeSize < 2 || m_initialCodeSize > 8)
     {
         Logger::err << "Invalid initial LZW code size: " << +m_initialCodeSize << Logger::End;
-        return {};
+        return 0;
     }
-    */
+    if (rowLength == 0 || rowCount == 0)
+        return 0;
 
-    uint8_t codeSize = m_initialCodeSize;
+    // The codes start one bit longer than the literals, to make room for the special codes
+    uint8_t codeSize = m_initialCodeSize + 1;
 
-    // A string that can contain null-bytes
-    using byteString_t = std::vector<uint8_t>;
+    LzwBitReader reader{m_subBlocks, m_subBlocksSize};
 
-    uint32_t currentBitOffset{};
+    const uint16_t clearCode{uint16_t(1 << m_initialCodeSize)};
+    const uint16_t endOfInformationCode{uint16_t(clearCode + 1)};
+    // Marks that there is no previous code after a clear code
+    const uint16_t noCode{0xffff};
 
-    /*
-     * Extracts `m_codeSize` number of bits from the input buffer.
-     */
-    auto extractDataFromBuffer{[](
-            uint32_t currentBitOffset,
-            uint8_t codeSize,
-            const byteString_t &inputBuffer
-            ){ // -> uint16_t
+    // The roots of the dictionary are the single bytes
+    for (uint16_t i{}; i < clearCode; ++i)
+    {
+        m_prefixes[i] = noCode;
+        m_suffixes[i] = uint8_t(i);
+        m_lengths[i] = 1;
+    }
+
+    uint16_t nextCode = endOfInformationCode + 1;
+    uint16_t prevCode{noCode};
 
-        uint32_t output{};
-        const uint32_t startByteOffset{currentBitOffset / 8};
-        const uint8_t bitsToShift{uint8_t(24 - currentBitOffset % 8 - codeSize)};
+    m_rowBuffer.resize(rowLength);
+    uint8_t* const row{m_rowBuffer.data()};
+    uint32_t rowFill{};
+    uint32_t rowI{};
 
-        // Data extraction:
+    /*
+     * Appends `length` bytes to the rows, passing the full rows to the callback.
+     */
+    auto outputBytes{[&](const uint8_t* bytes, uint32_t length){
+        while (length && rowI < rowCount)
         {
-            uint8_t outputBuff[3]{};
-            std::memcpy(&outputBuff, inputBuffer.data() + startByteOffset, 3);
-            output =
-                (uint32_t)outputBuff[0] << 16 |
-                (uint32_t)outputBuff[1] <<  8 |
-                (uint32_t)outputBuff[2] <<  0;
+            const uint32_t toCopy{std::min(length, rowLength - rowFill)};
+            std::memcpy(row + rowFill, bytes, toCopy);
+            rowFill += toCopy;
+            bytes += toCopy;
+            length -= toCopy;
+            if (rowFill == rowLength)
+            {
+                rowCallback(rowI++, row, rowLength);
+                rowFill = 0;
+            }
         }
-
-        output >>= bitsToShift;
-
-        uint16_t bitmask{};
-        for (int i{}; i < codeSize; ++i)
-            bitmask |= 1 << i;
-
-        output &= bitmask;
-
-        //Logger::log << std::bitset<32>(output) << Logger::End;
-
-        return uint16_t(output);
-    }};
-    
-    auto isClearCode{[](uint16_t value, uint8_t codeSize){
-        return value == (1 << codeSize);
-    }};
-
-    auto isEndOfInformationCode{[](uint16_t value, uint8_t codeSize){
-        return value == ((1 << codeSize) + 1);
     }};
 
-    byteString_t output;
+    /*
+     * Appends the string of `code` to the rows.
+     * Returns the first byte of the string.
+     */
+    auto outputString{[&](uint16_t code){ // -> uint8_t
+        const uint32_t length{m_lengths[code]};
+        // Write in place if the string fits in the row
+        const bool fitsInRow{rowFill + length <= rowLength};
+        uint8_t* const dest{fitsInRow ? row + rowFill : m_stringBuffer};
+        for (uint32_t i{length}; i-- > 0;)
+        {
+            dest[i] = m_suffixes[code];
+            code = m_prefixes[code];
+        }
 
-    std::unordered_map<uint16_t, byteString_t> dictionary;
-    for (uint16_t i{}; i < (1 << codeSize); ++i)
-        dictionary[i] = {(uint8_t)i};
+        const uint8_t firstByte{dest[0]};
+        if (fitsInRow)
+        {
+            rowFill += length;
+            if (rowFill == rowLength)
+            {
+                rowCallback(rowI++, row, rowLength);
+                rowFill = 0;
+            }
+        }
+        else
+        {
+            outputBytes(m_stringBuffer, length);
+        }
+        return firstByte;
+    }};
 
-    uint16_t nextPossibleCode = (1 << codeSize) + 2;
-    uint16_t prevCode{};
     uint16_t currCode{};
-    byteString_t string1;
-    byteString_t string2;
-
-    prevCode = extractDataFromBuffer(currentBitOffset, codeSize, m_inputBuffer);
-    currentBitOffset += codeSize;
-    string1 = dictionary[prevCode];
-    string2.push_back(string1[0]);
-
-    output.insert(output.end(), string1.begin(), string1.end());
-    while (currentBitOffset < m_inputBuffer.size() * 8)
+    while (rowI < rowCount && reader.read(codeSize, &currCode))
     {
-        currCode = extractDataFromBuffer(currentBitOffset, codeSize, m_inputBuffer);
-        currentBitOffset += codeSize;
-
-        if (isClearCode(prevCode, codeSize))
+        if (currCode == clearCode)
         {
-            Logger::log << "Decompressor: Clear code found" << Logger::End;
-
-            // Reset stuff
-            codeSize = m_initialCodeSize;
-            dictionary.clear();
-            for (uint16_t i{}; i < (1 << codeSize); ++i)
-                dictionary[i] = {(uint8_t)i};
-            nextPossibleCode = (1 << codeSize) + 2;
-
-            prevCode = currCode;
+            codeSize = m_initialCodeSize + 1;
+            nextCode = endOfInformationCode + 1;
+            prevCode = noCode;
             continue;
         }
-        if (isEndOfInformationCode(prevCode, codeSize))
+        if (currCode == endOfInformationCode)
         {
             Logger::log << "Decompressor: End of information code found" << Logger::End;
+            break;
+        }
 
+        if (prevCode == noCode) // First code after a clear code
+        {
+            if (currCode >= clearCode)
+            {
+                Logger::err << "Decompressor: Invalid first code: " << currCode << Logger::End;
+                break;
+            }
+            outputString(currCode);
             prevCode = currCode;
-            break;
+            continue;
         }
 
-        if (dictionary.find(currCode) == dictionary.end()) // If the code is NOT in the dictionary
+        uint8_t firstByte{};
+        if (currCode < nextCode) // If the code is in the dictionary
         {
-            string1 = dictionary[prevCode];
-            string1.insert(string1.end(), string2.begin(), string2.end()); // string1 += string2
+            firstByte = outputString(currCode);
         }
-        else // If the code is in the dictionary
+        else if (currCode == nextCode) // The code being defined: previous string + its first byte
         {
-            string1 = dictionary[currCode];
+            firstByte = outputString(prevCode);
+            outputBytes(&firstByte, 1);
+        }
+        else
+        {
+            Logger::err << "Decompressor: Invalid code: " << currCode << Logger::End;
+            break;
         }
 
-        //output.write((const char*)string1.data(), string1.size());
-        output.insert(output.end(), string1.begin(), string1.end());
-
-        string2 = {string1[0]};
-
-        byteString_t stringToInsert = dictionary.at(prevCode);
-        stringToInsert.insert(stringToInsert.end(), string2.begin(), string2.end());
-        dictionary[nextPossibleCode++] = stringToInsert;
-
-        if (dictionary.size() == (1ul << codeSize))
+        // When the dictionary is full, it is kept until the next clear code
+        if (nextCode < LZW_MAX_CODE_COUNT)
         {
-            ++codeSize;
-            Logger::log << "Incremented code size to " << +codeSize << Logger::End;
+            m_prefixes[nextCode] = prevCode;
+            m_suffixes[nextCode] = firstByte;
+            m_lengths[nextCode] = m_lengths[prevCode] + 1;
+            ++nextCode;
+
+            if (nextCode == (1 << codeSize) && codeSize < LZW_MAX_CODE_SIZE)
+                ++codeSize;
         }
 
         prevCode = currCode;
     }
 
-    Logger::log << std::dec << "Decompressor: Decompressed " << m_inputBuffer.size() << " bytes to " <<
-        output.size() << std::hex << Logger::End;
-    return output;
-}
+    // Truncated data
+    if (rowFill && rowI < rowCount)
+        rowCallback(rowI, row, rowFill);
 
+    Logger::log << std::dec << "Decompressor: Decompressed " << reader.getByteOffset() << " bytes to " <<
+        rowI << " rows" << std::hex << Logger::End;
+    return rowI;
+}
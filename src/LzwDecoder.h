@@ -26,19 +26,171 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "bitmagic.h"
 #include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <sstream>
 #include <vector>
 
+// Codes are at most 12 bits long
+#define LZW_MAX_CODE_SIZE   12
+#define LZW_MAX_CODE_COUNT  (1 << LZW_MAX_CODE_SIZE)
+
+/*
+ * Reads LSB-first codes of variable size from a chain of GIF data sub-blocks.
+ * Every sub-block starts with its size byte, the chain ends with a zero size.
+ *
+ * The bits are buffered in a 64-bit word that is refilled 8 bytes at a time,
+ * and one byte at a time near the end of a sub-block, so the size bytes are skipped
+ * and the reader never reads past the end of the buffer.
+ */
+class LzwBitReader final
+{
+private:
+    static constexpr uint16_t s_masks[LZW_MAX_CODE_SIZE + 1]{
+        0x000, 0x001, 0x003, 0x007, 0x00f, 0x01f, 0x03f, 0x07f, 0x0ff, 0x1ff, 0x3ff, 0x7ff, 0xfff};
+
+    const uint8_t* m_data{};
+    size_t m_size{};
+    size_t m_byteOffset{};
+    // The end of the data of the current sub-block
+    size_t m_subBlockEnd{};
+    uint64_t m_bitBuffer{};
+    // Number of valid bits in `m_bitBuffer`
+    uint32_t m_bitCount{};
+
+    /*
+     * Steps over the size byte of the next sub-block.
+     * Returns false at the block terminator or the end of the buffer.
+     */
+    inline bool _nextSubBlock()
+    {
+        if (m_byteOffset >= m_size || m_data[m_byteOffset] == 0)
+            return false;
+        m_subBlockEnd = std::min(m_size, m_byteOffset + 1 + m_data[m_byteOffset]);
+        ++m_byteOffset;
+        return true;
+    }
+
+    inline void _refill()
+    {
+        if (m_byteOffset + 8 <= m_subBlockEnd)
+        {
+            uint64_t word{};
+            std::memcpy(&word, m_data + m_byteOffset, 8);
+            // Only whole bytes are taken, the rest of the word is loaded again by the next refill
+            m_bitBuffer |= toNbo(word) << m_bitCount;
+            m_byteOffset += (63 - m_bitCount) / 8;
+            m_bitCount |= 56;
+        }
+        else // End of the sub-block
+        {
+            while (m_bitCount <= 56)
+            {
+                if (m_byteOffset == m_subBlockEnd && !_nextSubBlock())
+                    break;
+                m_bitBuffer |= uint64_t(m_data[m_byteOffset++]) << m_bitCount;
+                m_bitCount += 8;
+            }
+        }
+    }
+
+public:
+    /*
+     * `data` points to the size byte of the first sub-block,
+     * `size` is the number of bytes that can be read from there.
+     */
+    LzwBitReader(const uint8_t* data, size_t size)
+        : m_data{data}, m_size{size}
+    {
+    }
+
+    /*
+     * Returns the number of bytes read from the buffer, including the size bytes.
+     */
+    inline size_t getByteOffset() const { return m_byteOffset; }
+
+    /*
+     * Reads a code of `codeSize` bits, at most `LZW_MAX_CODE_SIZE`.
+     *
+     * Returns:
+     *      true, if succeded.
+     *      false if there are not enough bits left.
+     */
+    inline bool read(uint8_t codeSize, uint16_t* codeOut)
+    {
+        if (m_bitCount < codeSize)
+        {
+            _refill();
+            if (m_bitCount < codeSize)
+                return false;
+        }
+
+        *codeOut = uint16_t(m_bitBuffer & s_masks[codeSize]);
+        m_bitBuffer >>= codeSize;
+        m_bitCount -= codeSize;
+        return true;
+    }
+};
+
+/*
+ * Decompresses GIF LZW data.
+ *
+ * The dictionary is a fixed table: every code is stored as the code of its prefix
+ * string and its last byte, so adding a code never allocates.
+ * The output is produced one row at a time: strings are written backwards
+ * into the row buffer, walking the prefixes, and every full row is passed to a callback.
+ */
 class LzwDecoder final
 {
 private:
     uint8_t m_initialCodeSize{};
-    std::vector<uint8_t> m_inputBuffer{};
+    const uint8_t* m_subBlocks{};
+    size_t m_subBlocksSize{};
+
+    // The code of the string without its last byte
+    uint16_t m_prefixes[LZW_MAX_CODE_COUNT]{};
+    // The last byte of the string
+    uint8_t m_suffixes[LZW_MAX_CODE_COUNT]{};
+    // The length of the string
+    uint16_t m_lengths[LZW_MAX_CODE_COUNT]{};
+
+    // The row being decoded
+    std::vector<uint8_t> m_rowBuffer;
+    // Strings that don't fit in the rest of the row are assembled here
+    uint8_t m_stringBuffer[LZW_MAX_CODE_COUNT]{};
 
 public:
-    inline void setCodeSize(uint8_t value) { m_initialCodeSize = value; }
-    inline void operator<<(uint8_t value) { m_inputBuffer.push_back(value); }
-    std::vector<uint8_t> getDecompressedData();
+    /*
+     * Called with every decoded row: `length` values of the row `rowI`.
+     * `length` is less than the row length only for the last row of truncated data.
+     */
+    using rowCallback_t = std::function<void(uint32_t rowI, const uint8_t* values, uint32_t length)>;
+
+    /*
+     * Prepares the decoder for a new stream with LZW minimum code size `codeSize`.
+     * The compressed data is a chain of sub-blocks, read in place:
+     * `subBlocks` points to the size byte of the first sub-block,
+     * `size` is the number of bytes that can be read from there.
+     * The tables and the row buffer are kept, so reusing a decoder for
+     * many frames doesn't allocate memory.
+     */
+    inline void reset(uint8_t codeSize, const uint8_t* subBlocks, size_t size)
+    {
+        m_initialCodeSize = codeSize;
+        m_subBlocks = subBlocks;
+        m_subBlocksSize = size;
+    }
+
+    /*
+     * Decompresses the data to `rowCount` rows of `rowLength` values, passing every row to `rowCallback`.
+     * Decompression stops when all the rows are produced, at the end code or at the end of the data.
+     *
+     * Returns:
+     *      The number of complete rows decoded.
+     */
+    uint32_t decode(uint32_t rowLength, uint32_t rowCount, const rowCallback_t& rowCallback);
 };
 
@@ -29,15 +29,26 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "PnmImage.h"
 #include "Logger.h"
 #include "Gfx.h"
+#include "PnmScanner.h"
+#include "ThreadPool.h"
 #include "bitmagic.h"
 #include <SDL2/SDL_render.h>
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define PNM_MAX_BUFFER_SIZE -1_u32 // 4 gigs
+// Plain rasters at least this large are parsed on multiple threads
+#define PNM_PARALLEL_MIN_RASTER_SIZE (4 * 1024 * 1024)
+#define PNM_PARALLEL_MIN_CHUNK_SIZE (256 * 1024)
+#define PNM_PARALLEL_CHUNKS_PER_WORKER 4
+// Binary rows that need scaling are converted in parts of this many pixels
+#define PNM_ROW_PART_PIXELS 512
 
 static std::string pnmTypeToStr(PnmImage::PnmType type)
 {
@@ -49,61 +60,160 @@ static std::string pnmTypeToStr(PnmImage::PnmType type)
         case PnmImage::PnmType::PBM_Bin:   return "PBM Binary";
         case PnmImage::PnmType::PGM_Bin:   return "PGM Binary";
         case PnmImage::PnmType::PPM_Bin:   return "PPM Binary";
+        case PnmImage::PnmType::PAM:       return "PAM";
         default: return "Invalid";
     }
 }
 
-int PnmImage::fetchImageSize()
+int PnmImage::parsePamHeader(const uint8_t* data, uint32_t size, PamHeader* headerOut)
 {
-    auto skipWhitespace{[this](){
-        while (m_headerEndOffset < m_fileSize && std::isspace(m_buffer[m_headerEndOffset]))
-            ++m_headerEndOffset;
-    }};
+    static constexpr const char* whitespace{" \t\v\f\r"};
 
-    auto skipComments{[this](){
-        while (m_buffer[m_headerEndOffset] == '#')
+    PamHeader header{};
+    uint32_t offset{2}; // Skip the magic number
+    while (true)
+    {
+        const uint32_t lineStart{offset};
+        while (offset < size && data[offset] != '\n')
+            ++offset;
+        if (offset >= size)
         {
-            while (m_headerEndOffset < m_fileSize && m_buffer[m_headerEndOffset] != '\n')
-                ++m_headerEndOffset;
-            ++m_headerEndOffset;
+            Logger::err << "PAM header without ENDHDR" << Logger::End;
+            return 1;
         }
-    }};
+        const std::string line{(const char*)data + lineStart, offset - lineStart};
+        ++offset; // Skip the line break
 
-    auto getInt{[this](){ // -> unsigned int
-        std::stringstream ss{};
+        // Every line is a keyword and its value, or a comment
+        const size_t keywordStart{line.find_first_not_of(whitespace)};
+        if (keywordStart == std::string::npos || line[keywordStart] == '#')
+            continue;
+        const size_t keywordEnd{std::min(line.find_first_of(whitespace, keywordStart), line.size())};
+        const std::string keyword{line.substr(keywordStart, keywordEnd - keywordStart)};
+        const size_t valueStart{std::min(line.find_first_not_of(whitespace, keywordEnd), line.size())};
+        const size_t valueEnd{std::max(line.find_last_not_of(whitespace) + 1, valueStart)};
+        const std::string value{line.substr(valueStart, valueEnd - valueStart)};
+
+        uint32_t* field{};
+        if (keyword == "ENDHDR")
+        {
+            break;
+        }
+        else if (keyword == "TUPLTYPE")
+        {
+            header.tupleType += (header.tupleType.empty() ? "" : " ") + value;
+            continue;
+        }
+        else if (keyword == "WIDTH")
+        {
+            field = &header.widthPx;
+        }
+        else if (keyword == "HEIGHT")
+        {
+            field = &header.heightPx;
+        }
+        else if (keyword == "DEPTH")
+        {
+            field = &header.depth;
+        }
+        else if (keyword == "MAXVAL")
+        {
+            field = &header.maxPixelVal;
+        }
+        else
+        {
+            Logger::warn << "Unknown PAM header line, ignoring it: " << line << Logger::End;
+            continue;
+        }
 
-        while (m_headerEndOffset < m_fileSize && !std::isspace(m_buffer[m_headerEndOffset]))
+        char* end{};
+        const unsigned long long fieldValue{std::strtoull(value.c_str(), &end, 10)};
+        if (value.empty() || value[0] < '0' || value[0] > '9' || *end || fieldValue > -1_u32)
         {
-            ss << m_buffer[m_headerEndOffset];
-            ++m_headerEndOffset;
+            Logger::err << "Invalid PAM header line: " << line << Logger::End;
+            return 1;
         }
+        *field = uint32_t(fieldValue);
+    }
 
-        unsigned int output;
-        ss >> output;
-        return output;
-    }};
+    if (header.widthPx == 0 || header.heightPx == 0)
+    {
+        Logger::err << "Bitmap with zero or missing width or height" << Logger::End;
+        return 1;
+    }
+    if (header.maxPixelVal == 0 || header.maxPixelVal > 65535)
+    {
+        Logger::err << "Max sample value is missing or out of range" << Logger::End;
+        return 1;
+    }
+    if (header.depth == 0 || header.depth > 4)
+    {
+        Logger::err << "Unsupported PAM depth: " << header.depth << Logger::End;
+        return 1;
+    }
 
-    m_headerEndOffset = 2; // Skip the magic number
+    static const std::pair<const char*, uint32_t> tupleTypeDepths[]{
+        {"BLACKANDWHITE", 1}, {"GRAYSCALE", 1},
+        {"BLACKANDWHITE_ALPHA", 2}, {"GRAYSCALE_ALPHA", 2},
+        {"RGB", 3}, {"RGB_ALPHA", 4},
+    };
+    const auto tupleTypeIt{std::find_if(std::begin(tupleTypeDepths), std::end(tupleTypeDepths),
+            [&](const auto& tupleTypeDepth){ return header.tupleType == tupleTypeDepth.first; })};
+    if (tupleTypeIt == std::end(tupleTypeDepths))
+    {
+        // The tuple type is optional, the depth tells enough about the samples
+        if (!header.tupleType.empty())
+            Logger::warn << "Unknown PAM tuple type: \"" << header.tupleType <<
+            "\", interpreting the samples by the depth" << Logger::End;
+    }
+    else if (tupleTypeIt->second != header.depth)
+    {
+        Logger::err << "PAM tuple type " << header.tupleType << " doesn't match depth " << header.depth << Logger::End;
+        return 1;
+    }
 
-    skipWhitespace();
-    skipComments();
+    header.headerEndOffset = offset;
+    *headerOut = std::move(header);
+    return 0;
+}
 
-    m_bitmapWidthPx = getInt();
-    if (m_bitmapWidthPx <= 0)
+int PnmImage::fetchImageSize()
+{
+    if (m_type == PnmType::PAM)
     {
-        Logger::err << "Bitmap with zero width" << Logger::End;
-        return 1;
+        PamHeader header{};
+        if (parsePamHeader(m_buffer, m_fileSize, &header))
+            return 1;
+
+        m_bitmapWidthPx = header.widthPx;
+        m_bitmapHeightPx = header.heightPx;
+        m_samplesPerPixel = header.depth;
+        m_maxPixelVal = header.maxPixelVal;
+        m_headerEndOffset = header.headerEndOffset;
+        Logger::log << "Bitmap size: " << m_bitmapWidthPx << "x" << m_bitmapHeightPx <<
+            ", samples per pixel: " << m_samplesPerPixel << ", max sample value: " << m_maxPixelVal << Logger::End;
+        _buildScaleTable();
+        return 0;
     }
+    m_samplesPerPixel = (m_type == PnmType::PPM_Ascii || m_type == PnmType::PPM_Bin) ? 3 : 1;
 
-    skipWhitespace();
-    skipComments();
+    PnmScanner scanner{m_buffer, m_fileSize, 2}; // Skip the magic number
+
+    uint32_t width{};
+    if (!scanner.readInt(&width) || width == 0)
+    {
+        Logger::err << "Bitmap with zero or invalid width" << Logger::End;
+        return 1;
+    }
+    m_bitmapWidthPx = width;
 
-    m_bitmapHeightPx = getInt();
-    if (m_bitmapHeightPx <= 0)
+    uint32_t height{};
+    if (!scanner.readInt(&height) || height == 0)
     {
-        Logger::err << "Bitmap with zero height" << Logger::End;
+        Logger::err << "Bitmap with zero or invalid height" << Logger::End;
         return 1;
     }
+    m_bitmapHeightPx = height;
 
     Logger::log << "Bitmap size: " << m_bitmapWidthPx << "x" << m_bitmapHeightPx << Logger::End;
 
@@ -112,23 +222,52 @@ int PnmImage::fetchImageSize()
         m_type == PnmType::PPM_Ascii ||
         m_type == PnmType::PPM_Bin)
     {
-        skipComments();
-        ++m_headerEndOffset;
-
-        m_maxPixelVal = getInt();
-        Logger::log << "Max grayscale/color value: " << m_maxPixelVal << Logger::End;
-        if (m_maxPixelVal == 0)
+        uint32_t maxPixelVal{};
+        if (!scanner.readInt(&maxPixelVal))
         {
-            Logger::err << "Max grayscale/color value is set to zero" << Logger::End;
+            Logger::err << "Invalid max grayscale/color value" << Logger::End;
             return 1;
         }
-
-        ++m_headerEndOffset;
+        Logger::log << "Max grayscale/color value: " << maxPixelVal << Logger::End;
+        if (maxPixelVal == 0 || maxPixelVal > 65535)
+        {
+            Logger::err << "Max grayscale/color value is out of range" << Logger::End;
+            return 1;
+        }
+        m_maxPixelVal = maxPixelVal;
+        _buildScaleTable();
     }
 
+    // A single whitespace character separates the header from the raster
+    m_headerEndOffset = scanner.getOffset() + 1;
+
     return 0;
 }
 
+void PnmImage::_buildScaleTable()
+{
+    m_scaleTable.resize(m_maxPixelVal < 256 ? 256 : 65536);
+    for (size_t i{}; i < m_scaleTable.size(); ++i)
+    {
+        // Round to the nearest value
+        m_scaleTable[i] = i < m_maxPixelVal ? uint8_t((i * 255 + m_maxPixelVal / 2) / m_maxPixelVal) : 255;
+    }
+}
+
+int PnmImage::_parseBuffer()
+{
+    if (m_fileSize < 2 || m_buffer[0] != 'P' || m_buffer[1] < '1' || m_buffer[1] > '7')
+    {
+        Logger::err << "Invalid magic bytes" << Logger::End;
+        return 1;
+    }
+    m_type = PnmType(m_buffer[1] - '1');
+    Logger::log << "PNM type: " << pnmTypeToStr(m_type) << Logger::End;
+
+    // Fill m_bitmapWidthPx, m_bitmapHeightPx and m_headerEndOffset
+    return fetchImageSize();
+}
+
 int PnmImage::open(const std::string& filepath)
 {
     m_filePath.clear();
@@ -141,17 +280,6 @@ int PnmImage::open(const std::string& filepath)
     }
     Logger::log << "Opened file" << Logger::End;
 
-    char pnmTypeChars[3]{};
-    fileObject.read(pnmTypeChars, 2);
-    Logger::log << "Magic bytes (ASCII): " << pnmTypeChars << Logger::End;
-    if (pnmTypeChars[0] != 'P' || pnmTypeChars[1] < '1' || pnmTypeChars[1] > '6')
-    {
-        Logger::err << "Invalid magic bytes" << Logger::End;
-        return 1;
-    }
-    m_type = PnmType(pnmTypeChars[1] - '1');
-    Logger::log << "PNM type: " << pnmTypeToStr(m_type) << Logger::End;
-
     fileObject.seekg(0, std::ios::end);
     std::ios::pos_type fileSize{fileObject.tellg()};
     // If greater than the max 32-bit value (m_fileSize is 32-bit)
@@ -163,13 +291,14 @@ int PnmImage::open(const std::string& filepath)
     }
     m_fileSize = fileSize;
 
+    delete[] m_buffer;
     m_buffer = new uint8_t[m_fileSize];
+    m_bufferCapacity = m_fileSize;
     fileObject.seekg(0, std::ios::beg);
     fileObject.read((char*)m_buffer, m_fileSize);
     fileObject.close();
 
-    // Fill m_bitmapWidthPx, m_bitmapHeightPx and m_headerEndOffset
-    if (fetchImageSize())
+    if (_parseBuffer())
         return 1;
 
     m_filePath = filepath;
@@ -178,360 +307,556 @@ int PnmImage::open(const std::string& filepath)
     return 0;
 }
 
-int PnmImage::render(
-        SDL_Texture* texture, uint32_t viewportWidth, uint32_t viewportHeight) const
+int PnmImage::openMemory(const uint8_t* data, uint32_t size)
 {
-    if (!m_isInitialized)
+    // The frames of a stream usually have the same header, it is only parsed when it changes
+    const bool isSameHeader{m_isInitialized && m_headerEndOffset <= size &&
+        std::memcmp(m_buffer, data, m_headerEndOffset) == 0};
+    m_isInitialized = false;
+
+    if (size > m_bufferCapacity)
     {
-        Logger::err << "Cannot draw uninitialized image" << Logger::End;
-        return 1;
+        delete[] m_buffer;
+        m_buffer = new uint8_t[size];
+        m_bufferCapacity = size;
     }
+    std::memcpy(m_buffer, data, size);
+    m_fileSize = size;
 
-    SDL_Rect lockRect{0, 0, (int)viewportWidth, (int)viewportHeight};
-    uint8_t* pixelArray{};
-    int pitch{};
-    if (SDL_LockTexture(texture, &lockRect, (void**)&pixelArray, &pitch))
-    {
-        Logger::err << "Failed to lock texture: " << SDL_GetError() << Logger::End;
+    if (!isSameHeader && _parseBuffer())
         return 1;
-    }
 
-    int status{};
+    m_isInitialized = true;
+    return 0;
+}
+
+int PnmImage::renderToPixelArray(
+        uint8_t* pixelArray, uint32_t viewportWidth, uint32_t viewportHeight) const
+{
     switch (m_type)
     {
     case PnmType::PBM_Ascii:
     case PnmType::PGM_Ascii:
     case PnmType::PPM_Ascii:
-        status = _renderAsciiImage(pixelArray, viewportWidth, viewportHeight);
-        break;
+        return _renderAsciiImage(pixelArray, viewportWidth, viewportHeight);
 
     default:
-        status = _renderBinaryImage(pixelArray, viewportWidth, viewportHeight);
-        break;
+        return _renderBinaryImage(pixelArray, viewportWidth, viewportHeight);
     }
-
-    SDL_UnlockTexture(texture);
-    return status;
 }
 
-int PnmImage::_renderAsciiImage(
-        uint8_t* pixelArray,
-        uint32_t viewportWidth, uint32_t viewportHeight) const
+bool PnmImage::_putAsciiSample(AsciiDecodeContext* context, uint32_t value) const
 {
-    uint32_t offset{m_headerEndOffset}; // Skip header
-    uint32_t xPos{};
-    uint32_t yPos{};
-    std::stringstream ss{};
-    while (offset < m_fileSize)
-    {
-        // Handle comments if this is an ASCII image
-        if ((m_type == PnmType::PBM_Ascii ||
-             m_type == PnmType::PGM_Ascii ||
-             m_type == PnmType::PPM_Ascii) &&
-            m_buffer[offset] == '#')
+    switch (m_type)
+    {
+        case PnmType::PBM_Ascii:
         {
-            Logger::log << "Comment: \"";
-            while (m_buffer[offset] != '\n')
+            if (context->xPos < context->viewportWidth && context->yPos < context->viewportHeight)
             {
-                Logger::log << m_buffer[offset];
-                ++offset;
+                uint8_t colorVal{value ? 0_u8 : 255_u8};
+                Gfx::drawPointAt(context->pixelArray, m_bitmapWidthPx, context->xPos, context->yPos,
+                        {colorVal, colorVal, colorVal});
             }
-            ++offset;
-            Logger::log << "\"" << Logger::End;
-            continue;
-        }
+            break;
+        } // End of case
 
-        uint8_t currByte{m_buffer[offset]};
+        case PnmType::PGM_Ascii:
+        {
+            if (context->xPos < context->viewportWidth && context->yPos < context->viewportHeight)
+            {
+                uint8_t colorVal{m_scaleTable[value]};
+                Gfx::drawPointAt(context->pixelArray, m_bitmapWidthPx, context->xPos, context->yPos,
+                        {colorVal, colorVal, colorVal});
+            }
+            break;
+        } // End of case
 
-        switch (m_type)
+        case PnmType::PPM_Ascii:
         {
-            case PnmType::PBM_Ascii:
+            context->components[context->componentI] = value;
+            if (context->componentI < 2)
             {
-                if (xPos < viewportWidth && yPos < viewportHeight)
-                {
-                    if (!std::isspace(currByte))
-                    {
-                        if (currByte != '0' && currByte != '1')
-                            Logger::warn << "Invalid value while rendering Plain PNM image:" <<
-                                " as char: " << (char)currByte <<
-                                " as hex: " << +currByte <<
-                                ", treating it as nonzero" << Logger::End;
-
-                        uint8_t colorVal{(currByte != '0') ? 0_u8 : 255_u8};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorVal, colorVal, colorVal});
-
-                        ++xPos;
-                        if (xPos >= m_bitmapWidthPx)
-                        {
-                            xPos = 0;
-                            ++yPos;
-                            if (yPos >= m_bitmapHeightPx)
-                                return 0; // We are done
-                        }
-                    }
-                }
-                break;
-            } // End of case
+                // Next time we get the next color component
+                ++context->componentI;
+                return false;
+            }
+            // Next time we start a new color, so we get red then
+            context->componentI = 0;
 
-            case PnmType::PGM_Ascii:
+            // We have all the values for the color, draw it if the current pixel is visible
+            if (context->xPos < context->viewportWidth && context->yPos < context->viewportHeight)
             {
-                if (std::isspace(currByte))
-                {
-                    // This character (a whitespace) is the end of the current pixel value,
-                    // so convert the whole value to int
-                    uint16_t currValue{};
-                    ss.clear();
-                    ss >> currValue;
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorVal{uint8_t((float)currValue / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorVal, colorVal, colorVal});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
-                else
-                {
-                    ss.clear();
-                    // Add a new digit to the stream
-                    ss << m_buffer[offset];
-                }
-                break;
-            } // End of case
+                uint8_t colorR{m_scaleTable[context->components[0]]};
+                uint8_t colorG{m_scaleTable[context->components[1]]};
+                uint8_t colorB{m_scaleTable[context->components[2]]};
+                Gfx::drawPointAt(context->pixelArray, m_bitmapWidthPx, context->xPos, context->yPos,
+                        {colorR, colorG, colorB});
+            }
+            break;
+        } // End of case
+
+        default:
+            return true;
+    }
+
+    ++context->xPos;
+    if (context->xPos >= m_bitmapWidthPx)
+    {
+        context->xPos = 0;
+        ++context->yPos;
+        if (context->yPos >= m_bitmapHeightPx)
+            return true; // We are done
+    }
+    return false;
+}
 
-            case PnmType::PPM_Ascii:
+int PnmImage::_renderAsciiSamples(AsciiDecodeContext* context,
+        uint32_t offset, uint64_t skippedSampleCount, uint64_t sampleCount) const
+{
+    // The values of plain PBM images are single digits, they don't need to be separated
+    if (m_type == PnmType::PBM_Ascii)
+    {
+        for (; offset < m_fileSize && sampleCount; ++offset)
+        {
+            const uint8_t currByte{m_buffer[offset]};
+            switch (s_pnmCharClasses[currByte])
             {
-                if (std::isspace(currByte))
-                {
-                    /*
-                     * Specifies which value is the currently fetched.
-                     * If 0, this is the red,
-                     * if 1, this is the green,
-                     * if 2, this is the blue component.
-                     */
-                    static short valInRgbI{};
-                    static uint16_t rVal{};
-                    static uint16_t gVal{};
-                    static uint16_t bVal{};
-
-                    ss.clear();
-                    // This character (a whitespace) is the end of the current value,
-                    // so convert the whole value to int
-                    switch (valInRgbI)
-                    {
-                    case 0: ss >> rVal; break;
-                    case 1: ss >> gVal; break;
-                    case 2: ss >> bVal; break;
-                    }
-
-                    // If we have all the values for the color and
-                    // the current pixel is visible
-                    if (valInRgbI == 2 && xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorR{uint8_t((float)rVal / m_maxPixelVal * 255)};
-                        uint8_t colorG{uint8_t((float)gVal / m_maxPixelVal * 255)};
-                        uint8_t colorB{uint8_t((float)bVal / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
-                    }
-
-                    if (valInRgbI >= 2)
-                    {
-                        // Next time we start a new color, so we get red then
-                        valInRgbI = 0;
-
-                        ++xPos;
-                        if (xPos >= m_bitmapWidthPx)
-                        {
-                            xPos = 0;
-                            ++yPos;
-                            if (yPos >= m_bitmapHeightPx)
-                                return 0; // We are done
-                        }
-                    }
-                    else
-                    {
-                        // Next time we get the next color component
-                        ++valInRgbI;
-                    }
-                }
-                else
-                {
-                    ss.clear();
-                    // Add a new digit to the stream
-                    ss << m_buffer[offset];
-                }
-                break;
-            } // End of case
+            case PnmCharClass::Whitespace:
+                continue;
+
+            case PnmCharClass::Comment:
+                while (offset + 1 < m_fileSize && m_buffer[offset + 1] != '\n' && m_buffer[offset + 1] != '\r')
+                    ++offset;
+                continue;
 
             default:
                 break;
+            }
+
+            if (skippedSampleCount)
+            {
+                --skippedSampleCount;
+                continue;
+            }
+
+            if (currByte != '0' && currByte != '1')
+                Logger::warn << "Invalid value while rendering Plain PNM image:" <<
+                    " as char: " << (char)currByte <<
+                    " as hex: " << +currByte <<
+                    ", treating it as nonzero" << Logger::End;
+
+            --sampleCount;
+            if (_putAsciiSample(context, currByte != '0'))
+                return 0; // We are done
+        }
+        return 0;
+    }
+
+    PnmScanner scanner{m_buffer, m_fileSize, offset};
+    uint32_t currValue{};
+    while (sampleCount && scanner.readInt(&currValue))
+    {
+        if (skippedSampleCount)
+        {
+            --skippedSampleCount;
+            continue;
         }
 
-        ++offset;
+        --sampleCount;
+        // Values above the maximum would overflow the scaling
+        if (_putAsciiSample(context, std::min(currValue, uint32_t(m_maxPixelVal))))
+            return 0; // We are done
+    }
+
+    if (sampleCount && !scanner.isAtEnd())
+    {
+        const uint8_t currByte{m_buffer[scanner.getOffset()]};
+        Logger::warn << "Invalid value while rendering Plain PNM image:" <<
+            " as char: " << (char)currByte <<
+            " as hex: " << +currByte <<
+            ", stopping" << Logger::End;
+        return 1;
     }
 
     return 0;
 }
 
-
-int PnmImage::_renderBinaryImage(
-        uint8_t* pixelArray,
-        uint32_t viewportWidth, uint32_t viewportHeight) const
+/*
+ * Counts the samples of a plain raster between `begin` and `end`.
+ * `begin` must not be inside a comment or a value.
+ * Returns false if there is a character that is not a valid sample.
+ */
+static bool countAsciiSamples(
+        const uint8_t* data, size_t begin, size_t end, bool isBitmap, uint64_t* countOut)
 {
-    uint32_t xPos{};
-    uint32_t yPos{};
-
-    switch (m_type)
+    uint64_t count{};
+    bool isInValue{};
+    for (size_t offset{begin}; offset < end; ++offset)
     {
-        case PnmType::PBM_Bin:
+        switch (s_pnmCharClasses[data[offset]])
         {
-            for (uint32_t offset{m_headerEndOffset}; offset < m_fileSize; ++offset)
-            {
-                uint8_t currByte{m_buffer[offset]};
-                for (unsigned int i{}; i < 8; ++i)
-                {
-                    // XXX: Implement support for incomplete bytes at the end of lines
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorVal{(currByte & (1 << (7 - i))) ? 0_u8 : 255_u8};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorVal, colorVal, colorVal});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
-            }
+        case PnmCharClass::Whitespace:
+            isInValue = false;
             break;
-        } // End of case
 
-        case PnmType::PGM_Bin:
-        {
-            if (m_maxPixelVal < 256) // 1 byte values
+        case PnmCharClass::Comment:
+            while (offset + 1 < end && data[offset + 1] != '\n' && data[offset + 1] != '\r')
+                ++offset;
+            isInValue = false;
+            break;
+
+        case PnmCharClass::Digit:
+            if (isBitmap)
             {
-                for (uint32_t offset{m_headerEndOffset}; offset < m_fileSize; ++offset)
-                {
-                    uint8_t currByte{m_buffer[offset]};
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorVal{uint8_t((float)currByte / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorVal, colorVal, colorVal});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
+                if (data[offset] > '1')
+                    return false;
+                ++count;
             }
-            else // 2 byte values
+            else if (!isInValue)
             {
-                for (uint32_t offset{m_headerEndOffset}; offset < m_fileSize; offset += 2)
-                {
-                    uint16_t currWord{uint16_t((uint16_t)m_buffer[offset] << 8 | (uint16_t)m_buffer[offset + 1])};
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorVal{uint8_t((float)currWord / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorVal, colorVal, colorVal});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
+                ++count;
+                isInValue = true;
             }
             break;
-        } // End of case
 
-        case PnmType::PPM_Bin:
+        case PnmCharClass::Other:
+            return false;
+        }
+    }
+
+    *countOut = count;
+    return true;
+}
+
+int PnmImage::_renderAsciiImageParallel(
+        uint8_t* pixelArray,
+        uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    ThreadPool pool{};
+    const size_t rasterSize{m_fileSize - m_headerEndOffset};
+    const size_t chunkSize{std::max(rasterSize / (pool.getWorkerCount() * PNM_PARALLEL_CHUNKS_PER_WORKER),
+            size_t(PNM_PARALLEL_MIN_CHUNK_SIZE))};
+
+    // Move every chunk boundary forward to whitespace that is not in a comment,
+    // so no value or comment is split between chunks
+    std::vector<size_t> chunkStarts{m_headerEndOffset};
+    for (size_t boundary{m_headerEndOffset + chunkSize}; boundary < m_fileSize; boundary += chunkSize)
+    {
+        while (boundary < m_fileSize && s_pnmCharClasses[m_buffer[boundary]] != PnmCharClass::Whitespace)
+            ++boundary;
+
+        // We are in a comment if there is a '#' since the last line break
+        // (the previous boundary is known to be outside comments)
+        bool isInComment{};
+        for (size_t offset{boundary}; offset > chunkStarts.back(); --offset)
         {
-            if (m_maxPixelVal < 256) // 1 byte values
-            {
-                for (uint32_t offset{m_headerEndOffset}; offset < m_fileSize; offset += 3)
-                {
-                    uint8_t rVal{m_buffer[offset + 0]};
-                    uint8_t gVal{m_buffer[offset + 1]};
-                    uint8_t bVal{m_buffer[offset + 2]};
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorR{uint8_t((float)rVal / m_maxPixelVal * 255)};
-                        uint8_t colorG{uint8_t((float)gVal / m_maxPixelVal * 255)};
-                        uint8_t colorB{uint8_t((float)bVal / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
-            }
-            else // 2 byte values
+            const uint8_t currByte{m_buffer[offset - 1]};
+            if (currByte == '\n' || currByte == '\r')
+                break;
+            if (currByte == '#')
             {
-                for (uint32_t offset{m_headerEndOffset}; offset < m_fileSize; offset += 3*2)
-                {
-                    uint16_t rVal{uint16_t((uint16_t)m_buffer[offset + 0] << 8 | (uint16_t)m_buffer[offset + 1])};
-                    uint16_t gVal{uint16_t((uint16_t)m_buffer[offset + 1] << 8 | (uint16_t)m_buffer[offset + 3])};
-                    uint16_t bVal{uint16_t((uint16_t)m_buffer[offset + 4] << 8 | (uint16_t)m_buffer[offset + 5])};
-
-                    if (xPos < viewportWidth && yPos < viewportHeight)
-                    {
-                        uint8_t colorR{uint8_t((float)rVal / m_maxPixelVal * 255)};
-                        uint8_t colorG{uint8_t((float)gVal / m_maxPixelVal * 255)};
-                        uint8_t colorB{uint8_t((float)bVal / m_maxPixelVal * 255)};
-                        Gfx::drawPointAt(pixelArray, m_bitmapWidthPx, xPos, yPos, {colorR, colorG, colorB});
-                    }
-
-                    ++xPos;
-                    if (xPos >= m_bitmapWidthPx)
-                    {
-                        xPos = 0;
-                        ++yPos;
-                        if (yPos >= m_bitmapHeightPx)
-                            return 0; // We are done
-                    }
-                }
+                isInComment = true;
+                break;
             }
-            break;
-        } // End of case
+        }
+        if (isInComment)
+        {
+            while (boundary < m_fileSize && m_buffer[boundary] != '\n' && m_buffer[boundary] != '\r')
+                ++boundary;
+        }
 
-        default:
+        if (boundary >= m_fileSize)
             break;
+        chunkStarts.push_back(boundary);
+    }
+    chunkStarts.push_back(m_fileSize);
+    const size_t chunkCount{chunkStarts.size() - 1};
+
+    // Phase 1: count the samples in each chunk
+    std::vector<uint64_t> sampleCounts(chunkCount);
+    std::vector<uint8_t> areChunksValid(chunkCount);
+    const bool isBitmap{m_type == PnmType::PBM_Ascii};
+    for (size_t i{}; i < chunkCount; ++i)
+    {
+        pool.post([&, i](){
+            areChunksValid[i] = countAsciiSamples(
+                    m_buffer, chunkStarts[i], chunkStarts[i + 1], isBitmap, &sampleCounts[i]);
+        });
+    }
+    pool.waitAll();
+
+    // Let the serial renderer report the invalid values
+    if (std::find(areChunksValid.begin(), areChunksValid.end(), 0) != areChunksValid.end())
+        return 1;
+
+    // Phase 2: render the chunks at the pixels their first samples belong to.
+    // A pixel split between chunks is rendered by the chunk it starts in.
+    const uint64_t samplesPerPixel{m_type == PnmType::PPM_Ascii ? 3_u64 : 1_u64};
+    const uint64_t imageSampleCount{uint64_t(m_bitmapWidthPx) * m_bitmapHeightPx * samplesPerPixel};
+    auto alignToPixel{[&](uint64_t sampleI){
+        return std::min((sampleI + samplesPerPixel - 1) / samplesPerPixel * samplesPerPixel, imageSampleCount);
+    }};
+    uint64_t chunkFirstSampleI{};
+    for (size_t i{}; i < chunkCount; ++i)
+    {
+        const uint64_t firstRenderedSampleI{alignToPixel(chunkFirstSampleI)};
+        const uint64_t lastRenderedSampleI{alignToPixel(chunkFirstSampleI + sampleCounts[i])};
+        if (lastRenderedSampleI > firstRenderedSampleI)
+        {
+            pool.post([=](){
+                const uint64_t pixelI{firstRenderedSampleI / samplesPerPixel};
+                AsciiDecodeContext context{};
+                context.pixelArray = pixelArray;
+                context.viewportWidth = viewportWidth;
+                context.viewportHeight = viewportHeight;
+                context.xPos = pixelI % m_bitmapWidthPx;
+                context.yPos = pixelI / m_bitmapWidthPx;
+                _renderAsciiSamples(&context, chunkStarts[i],
+                        firstRenderedSampleI - chunkFirstSampleI, lastRenderedSampleI - firstRenderedSampleI);
+            });
+        }
+        chunkFirstSampleI += sampleCounts[i];
+    }
+    pool.waitAll();
+
+    return 0;
+}
+
+int PnmImage::_renderAsciiImage(
+        uint8_t* pixelArray,
+        uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    // On a pool worker the other cores are already busy with the other tasks of the pool
+    if (m_fileSize > m_headerEndOffset
+            && m_fileSize - m_headerEndOffset >= PNM_PARALLEL_MIN_RASTER_SIZE
+            && std::thread::hardware_concurrency() > 1
+            && !ThreadPool::isWorkerThread()
+            && !_renderAsciiImageParallel(pixelArray, viewportWidth, viewportHeight))
+        return 0;
+
+    AsciiDecodeContext context{};
+    context.pixelArray = pixelArray;
+    context.viewportWidth = viewportWidth;
+    context.viewportHeight = viewportHeight;
+    _renderAsciiSamples(&context, m_headerEndOffset, 0, -1_u64);
+    return 0;
+}
+
+
+int PnmImage::_renderBinaryImage(
+        uint8_t* pixelArray,
+        uint32_t viewportWidth, uint32_t viewportHeight) const
+{
+    (void)viewportWidth; // The rows are always rendered whole
+
+    for (uint32_t row{}; row < m_bitmapHeightPx && row < viewportHeight; ++row)
+    {
+        if (_renderRow(pixelArray + size_t(row) * m_bitmapWidthPx * 4, row))
+            return 1;
     }
 
     return 0;
 }
 
+bool PnmImage::_getRowByteRange(uint32_t row, uint64_t* offsetOut, uint64_t* sizeOut) const
+{
+    if (m_type == PnmType::PBM_Bin)
+    {
+        // Every row starts on a byte boundary
+        *sizeOut = (uint64_t(m_bitmapWidthPx) + 7) / 8;
+        *offsetOut = m_headerEndOffset + *sizeOut * row;
+        return true;
+    }
+
+    if (m_type != PnmType::PGM_Bin && m_type != PnmType::PPM_Bin && m_type != PnmType::PAM)
+        return false;
+
+    const uint64_t bytesPerPixel{uint64_t(m_samplesPerPixel) * (m_maxPixelVal < 256 ? 1 : 2)};
+    *sizeOut = bytesPerPixel * m_bitmapWidthPx;
+    *offsetOut = m_headerEndOffset + *sizeOut * row;
+    return true;
+}
+
+/*
+ * The RGBA pixels of the 8 bits of every byte of a binary PBM raster, MSB first.
+ * A set bit is black.
+ */
+static constexpr std::array<std::array<uint8_t, 32>, 256> makePbmByteExpansions()
+{
+    std::array<std::array<uint8_t, 32>, 256> expansions{};
+    for (size_t byte{}; byte < 256; ++byte)
+    {
+        for (size_t bitI{}; bitI < 8; ++bitI)
+        {
+            const uint8_t colorVal{(byte & (0x80 >> bitI)) ? 0_u8 : 255_u8};
+            expansions[byte][bitI * 4 + 0] = colorVal;
+            expansions[byte][bitI * 4 + 1] = colorVal;
+            expansions[byte][bitI * 4 + 2] = colorVal;
+            expansions[byte][bitI * 4 + 3] = 255;
+        }
+    }
+    return expansions;
+}
+
+static constexpr std::array<std::array<uint8_t, 32>, 256> s_pbmByteExpansions{makePbmByteExpansions()};
+
+/*
+ * Expands 8-bit gray, gray and alpha, RGB or RGBA samples to RGBA pixels.
+ */
+static void expandSamplesToRgba(
+        const uint8_t* samples, uint32_t samplesPerPixel, size_t pixelCount, uint8_t* rgbaOut)
+{
+    switch (samplesPerPixel)
+    {
+    case 1:  Gfx::expandGrayToRgba(samples, pixelCount, rgbaOut); break;
+    case 2:  Gfx::expandGrayAlphaToRgba(samples, pixelCount, rgbaOut); break;
+    case 3:  Gfx::expandRgbToRgba(samples, pixelCount, rgbaOut); break;
+    default: std::memcpy(rgbaOut, samples, pixelCount * 4); break;
+    }
+}
+
+int PnmImage::_renderRow(uint8_t* rowPixels, uint32_t row) const
+{
+    uint64_t offset{};
+    uint64_t rowSize{};
+    if (!_getRowByteRange(row, &offset, &rowSize))
+        return 1;
+    if (offset >= m_fileSize) // Truncated file
+        return 0;
+
+    if (m_type == PnmType::PBM_Bin)
+    {
+        // Render the available bytes of a truncated row
+        const uint32_t byteCount{uint32_t(std::min(rowSize, m_fileSize - offset))};
+        const uint32_t fullByteCount{std::min(byteCount, m_bitmapWidthPx / 8)};
+        for (uint32_t byteI{}; byteI < fullByteCount; ++byteI)
+            std::memcpy(rowPixels + size_t(byteI) * 32, s_pbmByteExpansions[m_buffer[offset + byteI]].data(), 32);
+        // The padding bits of the last byte are ignored
+        if (fullByteCount < byteCount)
+        {
+            std::memcpy(rowPixels + size_t(fullByteCount) * 32,
+                    s_pbmByteExpansions[m_buffer[offset + fullByteCount]].data(), (m_bitmapWidthPx % 8) * 4);
+        }
+        return 0;
+    }
+
+    const uint32_t bytesPerPixel{uint32_t(rowSize / m_bitmapWidthPx)};
+    const uint32_t samplesPerPixel{m_samplesPerPixel};
+    // Render the complete pixels of a truncated row
+    const uint32_t pixelCount{uint32_t(std::min(uint64_t(m_bitmapWidthPx), (m_fileSize - offset) / bytesPerPixel))};
+    const uint8_t* samples{m_buffer + offset};
+
+    // No scaling needed, just add the missing channels
+    if (m_maxPixelVal == 255)
+    {
+        expandSamplesToRgba(samples, samplesPerPixel, pixelCount, rowPixels);
+        return 0;
+    }
+
+    // The row is scaled to 8 bits in parts, then expanded to RGBA
+    uint8_t scaledSamples[PNM_ROW_PART_PIXELS * 4];
+    uint16_t wideSamples[PNM_ROW_PART_PIXELS * 4];
+    for (uint32_t partStart{}; partStart < pixelCount; partStart += PNM_ROW_PART_PIXELS)
+    {
+        const uint32_t partPixelCount{std::min(pixelCount - partStart, uint32_t(PNM_ROW_PART_PIXELS))};
+        const uint32_t partSampleCount{partPixelCount * samplesPerPixel};
+        const uint8_t* partSamples{samples + size_t(partStart) * bytesPerPixel};
+
+        if (m_maxPixelVal < 256)
+        {
+            for (uint32_t i{}; i < partSampleCount; ++i)
+                scaledSamples[i] = m_scaleTable[partSamples[i]];
+        }
+        else if (m_maxPixelVal == 65535)
+        {
+            Gfx::scaleBe16To8(partSamples, partSampleCount, scaledSamples);
+        }
+        else
+        {
+            Gfx::loadBe16(partSamples, partSampleCount, wideSamples);
+            for (uint32_t i{}; i < partSampleCount; ++i)
+                scaledSamples[i] = m_scaleTable[wideSamples[i]];
+        }
+
+        expandSamplesToRgba(scaledSamples, samplesPerPixel, partPixelCount, rowPixels + size_t(partStart) * 4);
+    }
+
+    return 0;
+}
+
+std::shared_ptr<DecodedImage> PnmImage::decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const
+{
+    if (!m_isInitialized || m_maxPixelVal >= 256 ||
+        (m_type != PnmType::PGM_Bin && m_type != PnmType::PPM_Bin))
+        return Image::decodeThumbnail(maxWidthPx, maxHeightPx);
+
+    uint32_t thumbWidth{};
+    uint32_t thumbHeight{};
+    _getThumbnailSize(maxWidthPx, maxHeightPx, &thumbWidth, &thumbHeight);
+    auto thumbnail{std::make_shared<DecodedImage>(thumbWidth, thumbHeight)};
+
+    const uint32_t bytesPerPixel{m_type == PnmType::PPM_Bin ? 3_u32 : 1_u32};
+    for (uint32_t dstY{}; dstY < thumbHeight; ++dstY)
+    {
+        // Sample the center of the area covered by the thumbnail pixel
+        const uint32_t srcY{uint32_t((uint64_t(dstY) * 2 + 1) * m_bitmapHeightPx / (thumbHeight * 2))};
+        for (uint32_t dstX{}; dstX < thumbWidth; ++dstX)
+        {
+            const uint32_t srcX{uint32_t((uint64_t(dstX) * 2 + 1) * m_bitmapWidthPx / (thumbWidth * 2))};
+            const uint64_t offset{m_headerEndOffset + (uint64_t(srcY) * m_bitmapWidthPx + srcX) * bytesPerPixel};
+            if (offset + bytesPerPixel > m_fileSize) // Truncated file
+                continue;
+
+            uint8_t colorR{m_scaleTable[m_buffer[offset]]};
+            uint8_t colorG{colorR};
+            uint8_t colorB{colorR};
+            if (m_type == PnmType::PPM_Bin)
+            {
+                colorG = m_scaleTable[m_buffer[offset + 1]];
+                colorB = m_scaleTable[m_buffer[offset + 2]];
+            }
+            Gfx::drawPointAt(thumbnail->getPixels(), thumbWidth, dstX, dstY, {colorR, colorG, colorB});
+        }
+    }
+
+    return thumbnail;
+}
+
+std::shared_ptr<DecodedWideImage> PnmImage::decodeWide() const
+{
+    if (!m_isInitialized || m_type == PnmType::PBM_Ascii || m_type == PnmType::PBM_Bin)
+        return nullptr;
+
+    auto wideImage{std::make_shared<DecodedWideImage>(
+            m_bitmapWidthPx, m_bitmapHeightPx, m_samplesPerPixel, m_maxPixelVal)};
+    uint16_t* samples{wideImage->getSamples()};
+    const uint64_t sampleCount{uint64_t(m_bitmapWidthPx) * m_bitmapHeightPx * m_samplesPerPixel};
+
+    // The pixels are decoded until the first invalid or missing sample, like by the renderers
+    if (isSlowToDecode())
+    {
+        PnmScanner scanner{m_buffer, m_fileSize, m_headerEndOffset};
+        uint32_t value{};
+        uint64_t sampleI{};
+        for (; sampleI < sampleCount && scanner.readInt(&value); ++sampleI)
+            samples[sampleI] = uint16_t(std::min(value, uint32_t(m_maxPixelVal)));
+        wideImage->setDecodedPixelCount(sampleI / m_samplesPerPixel);
+        return wideImage;
+    }
+
+    const uint32_t bytesPerSample{m_maxPixelVal < 256 ? 1_u32 : 2_u32};
+    const uint64_t rasterSize{m_fileSize > m_headerEndOffset ? m_fileSize - m_headerEndOffset : 0};
+    const size_t availableCount{size_t(std::min(sampleCount, rasterSize / bytesPerSample))};
+    const uint8_t* raster{m_buffer + m_headerEndOffset};
+    if (bytesPerSample == 1)
+        std::copy(raster, raster + availableCount, samples);
+    else
+        Gfx::loadBe16(raster, availableCount, samples);
+    wideImage->setDecodedPixelCount(availableCount / m_samplesPerPixel);
+
+    return wideImage;
+}
+
 PnmImage::~PnmImage()
 {
     delete[] m_buffer;
@@ -31,6 +31,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "Image.h"
 #include "Logger.h"
 #include <SDL2/SDL.h>
+#include <string>
+#include <vector>
 
 /*
  * This class can open PNM images.
@@ -39,6 +41,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *      + PBM (Portable BitMap) is binary/ASCII 1-bit
  *      + PGM (Portable GrayMap) is binary/ASCII 8-bit
  *      + PPM (Portable PixMap) is binary/ASCII 24-bit
+ *      + PAM (Portable Arbitrary Map) is binary gray or RGB, with or without alpha
+ *
+ * The samples can be up to 16-bit in every type but PBM.
  */
 class PnmImage final : public Image
 {
@@ -51,6 +56,23 @@ public:
         PBM_Bin,    // binary 1-bit
         PGM_Bin,    // binary 8-bit
         PPM_Bin,    // binary 24-bit
+        PAM,        // binary, 1 to 4 samples per pixel
+    };
+
+    /*
+     * The fields of a PAM header.
+     */
+    struct PamHeader
+    {
+        uint32_t widthPx{};
+        uint32_t heightPx{};
+        // Number of samples per pixel
+        uint32_t depth{};
+        uint32_t maxPixelVal{};
+        // The TUPLTYPE lines joined with spaces, like "RGB_ALPHA"
+        std::string tupleType;
+        // The first byte of the raster, after the ENDHDR line
+        uint32_t headerEndOffset{};
     };
 
 private:
@@ -65,8 +87,66 @@ private:
      * Used for grayscale images.
      */
     uint16_t m_maxPixelVal{};
+    /*
+     * Number of samples of a pixel:
+     * 1 for gray, 2 for gray and alpha, 3 for RGB and 4 for RGBA.
+     */
+    uint32_t m_samplesPerPixel{};
+    /*
+     * Maps the samples to 8-bit values, built once the maximum value is known.
+     * Covers every possible sample, the ones above the maximum are mapped to 255.
+     */
+    std::vector<uint8_t> m_scaleTable;
+    // Allocated size of `m_buffer`, it can be larger than the image
+    uint32_t m_bufferCapacity{};
+
+    void _buildScaleTable();
 
     virtual int fetchImageSize();
+    // Checks the magic bytes and reads the header from `m_buffer`
+    int _parseBuffer();
+
+    /*
+     * The state of rendering a plain (ASCII) raster.
+     * Every render call has its own, so images can be decoded concurrently.
+     */
+    struct AsciiDecodeContext
+    {
+        uint8_t* pixelArray{};
+        uint32_t viewportWidth{};
+        uint32_t viewportHeight{};
+        uint32_t xPos{};
+        uint32_t yPos{};
+        /*
+         * Specifies which component of a PPM pixel is fetched next.
+         * If 0, this is the red,
+         * if 1, this is the green,
+         * if 2, this is the blue component.
+         */
+        uint32_t componentI{};
+        uint32_t components[3]{};
+    };
+
+    /*
+     * Puts the next sample (a bit, gray value or color component) to the pixel array.
+     * Returns true when the last pixel of the image has been rendered.
+     */
+    bool _putAsciiSample(AsciiDecodeContext* context, uint32_t value) const;
+    /*
+     * Renders the plain raster samples starting at byte `offset`.
+     * The first `skippedSampleCount` samples are skipped, then at most `sampleCount` are rendered.
+     * Returns 1 if an invalid value was found, 0 otherwise.
+     */
+    int _renderAsciiSamples(AsciiDecodeContext* context,
+            uint32_t offset, uint64_t skippedSampleCount, uint64_t sampleCount) const;
+    /*
+     * Splits a large plain raster into chunks at whitespace, counts the samples of
+     * each chunk, then renders the chunks concurrently.
+     * Returns 1 if the raster contains invalid values, so the caller has to render it serially.
+     */
+    int _renderAsciiImageParallel(
+            uint8_t* pixelArray,
+            uint32_t viewportWidth, uint32_t viewportHeight) const;
 
     /*
      * Ascii images are rendered by going thru the file char by char and processing it.
@@ -81,11 +161,43 @@ private:
             uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const;
 
+    // Binary images are row-addressable
+    virtual bool _getRowByteRange(uint32_t row, uint64_t* offsetOut, uint64_t* sizeOut) const override;
+    virtual int _renderRow(uint8_t* rowPixels, uint32_t row) const override;
+
 public:
+    /*
+     * Parses the header of the PAM image at the start of `data`, after the magic number.
+     * Gray and RGB images are supported, with or without alpha.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if the header is invalid, unsupported or incomplete.
+     */
+    static int parsePamHeader(const uint8_t* data, uint32_t size, PamHeader* headerOut);
+
     virtual int open(const std::string &filepath) override;
-    virtual int render(
-            SDL_Texture* texture,
+    /*
+     * Opens an image that is already in memory, like a frame of a stream.
+     * The data is copied, the buffer of the previous image is reused if it is large enough.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int openMemory(const uint8_t* data, uint32_t size);
+    virtual int renderToPixelArray(
+            uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const override;
+    // Binary 8-bit images are subsampled, only the used pixels are read
+    virtual std::shared_ptr<DecodedImage> decodeThumbnail(uint32_t maxWidthPx, uint32_t maxHeightPx) const override;
+    // Every type but PBM keeps its samples
+    virtual std::shared_ptr<DecodedWideImage> decodeWide() const override;
+    // Parsing ASCII images is slow
+    virtual bool isSlowToDecode() const override
+    {
+        return m_type == PnmType::PBM_Ascii || m_type == PnmType::PGM_Ascii || m_type == PnmType::PPM_Ascii;
+    }
 
     virtual ~PnmImage() override;
 };
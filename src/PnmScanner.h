@@ -0,0 +1,187 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "bitmagic.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+/*
+ * The kinds of characters in the plain (ASCII) PNM formats.
+ */
+enum class PnmCharClass : uint8_t
+{
+    Other,
+    Whitespace,
+    Digit,
+    Comment, // '#', the comment lasts until the end of the line
+};
+
+static constexpr std::array<PnmCharClass, 256> makePnmCharClasses()
+{
+    std::array<PnmCharClass, 256> classes{};
+    for (char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+        classes[uint8_t(c)] = PnmCharClass::Whitespace;
+    for (char c{'0'}; c <= '9'; ++c)
+        classes[uint8_t(c)] = PnmCharClass::Digit;
+    classes[uint8_t('#')] = PnmCharClass::Comment;
+    return classes;
+}
+
+inline constexpr std::array<PnmCharClass, 256> s_pnmCharClasses{makePnmCharClasses()};
+
+/*
+ * Reads the unsigned decimal integers of a PNM header or a plain PNM raster.
+ *
+ * Whitespace and comments are skipped with a lookup table.
+ * Up to 8 digits are converted at once by treating them as the bytes of a 64-bit word,
+ * the scanner only falls back to one digit at a time near the end of the buffer.
+ */
+class PnmScanner final
+{
+private:
+    const uint8_t* m_data{};
+    size_t m_size{};
+    size_t m_offset{};
+
+    /*
+     * Converts the digits at the start of the 8 bytes at `data`.
+     * Returns the number of digits (0 to 8), their value is put into `valueOut`.
+     */
+    static inline uint32_t _parseEightDigits(const uint8_t* data, uint32_t* valueOut)
+    {
+        uint64_t chunk;
+        std::memcpy(&chunk, data, 8);
+        // The first character goes to the lowest byte
+        chunk = toNbo(chunk);
+
+        // Digits become 0..9, every other character becomes a byte above 9
+        const uint64_t values{chunk ^ 0x3030303030303030_u64};
+        // The high bit of a byte is set if it is not a digit.
+        // The addition can't carry into the next byte, since the high bits are masked out.
+        const uint64_t nonDigits{
+            (((values & 0x7f7f7f7f7f7f7f7f_u64) + 0x7676767676767676_u64) | values) & 0x8080808080808080_u64};
+        // Set the low bit of each byte before the first non-digit one and sum them in the top byte
+        const uint64_t lowestNonDigit{nonDigits & (~nonDigits + 1)};
+        const uint32_t digitCount{uint32_t(
+                ((((lowestNonDigit >> 7) - 1) & 0x0101010101010101_u64) * 0x0101010101010101_u64) >> 56)};
+        if (digitCount == 0)
+        {
+            *valueOut = 0;
+            return 0;
+        }
+
+        // Shift out the non-digits, the bytes shifted in become leading zeros
+        uint64_t digits{values << (8 * (8 - digitCount))};
+        // Combine the neighbouring digits, then the pairs, then the quadruples
+        digits = ((digits * 10) + (digits >> 8)) & 0x00ff00ff00ff00ff_u64;
+        digits = ((digits * 100) + (digits >> 16)) & 0x0000ffff0000ffff_u64;
+        digits = ((digits * 10000) + (digits >> 32)) & 0x00000000ffffffff_u64;
+        *valueOut = uint32_t(digits);
+        return digitCount;
+    }
+
+public:
+    PnmScanner(const uint8_t* data, size_t size, size_t offset=0)
+        : m_data{data}, m_size{size}, m_offset{offset}
+    {
+    }
+
+    /*
+     * Skips the whitespace and the comments.
+     */
+    inline void skipWhitespace()
+    {
+        while (m_offset < m_size)
+        {
+            switch (s_pnmCharClasses[m_data[m_offset]])
+            {
+            case PnmCharClass::Whitespace:
+                ++m_offset;
+                break;
+
+            case PnmCharClass::Comment:
+                while (m_offset < m_size && m_data[m_offset] != '\n' && m_data[m_offset] != '\r')
+                    ++m_offset;
+                break;
+
+            default:
+                return;
+            }
+        }
+    }
+
+    /*
+     * Reads the next integer, skipping the whitespace and the comments before it.
+     * The offset is left at the character after the last digit.
+     * Values that don't fit into 32 bits are saturated.
+     *
+     * Returns:
+     *   true if an integer was read,
+     *   false at the end of the data or if the integer is not followed by whitespace or a comment.
+     *   In the latter case the offset is left at the invalid character.
+     */
+    inline bool readInt(uint32_t* valueOut)
+    {
+        skipWhitespace();
+
+        uint64_t value{};
+        bool hasDigits{};
+        if (m_offset + 8 <= m_size)
+        {
+            uint32_t chunkValue{};
+            const uint32_t digitCount{_parseEightDigits(m_data + m_offset, &chunkValue)};
+            m_offset += digitCount;
+            value = chunkValue;
+            hasDigits = digitCount != 0;
+        }
+        // Near the end of the buffer and after the 8th digit
+        while (m_offset < m_size && s_pnmCharClasses[m_data[m_offset]] == PnmCharClass::Digit)
+        {
+            value = std::min(value * 10 + (m_data[m_offset] - '0'), uint64_t(-1_u32));
+            hasDigits = true;
+            ++m_offset;
+        }
+
+        if (!hasDigits ||
+            (m_offset < m_size && s_pnmCharClasses[m_data[m_offset]] != PnmCharClass::Whitespace
+                && s_pnmCharClasses[m_data[m_offset]] != PnmCharClass::Comment))
+            return false;
+
+        *valueOut = uint32_t(value);
+        return true;
+    }
+
+    inline size_t getOffset() const { return m_offset; }
+    inline void setOffset(size_t offset) { m_offset = offset; }
+    inline bool isAtEnd() const { return m_offset >= m_size; }
+};
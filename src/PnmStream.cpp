@@ -0,0 +1,363 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "PnmStream.h"
+#include "PnmScanner.h"
+#include "Logger.h"
+#include "bitmagic.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+bool PnmStream::isStreamPath(const std::string& path)
+{
+    std::error_code error;
+    return path == "-" || std::filesystem::is_fifo(path, error);
+}
+
+int PnmStream::open(const std::string& path)
+{
+    if (path == "-")
+    {
+        m_fd = STDIN_FILENO;
+        m_isFdOwned = false;
+    }
+    else
+    {
+        m_fd = ::open(path.c_str(), O_RDONLY);
+        if (m_fd < 0)
+        {
+            Logger::err << "Failed to open stream: " << strerror(errno) << Logger::End;
+            return 1;
+        }
+        m_isFdOwned = true;
+    }
+    Logger::log << "Reading PNM stream: " << path << Logger::End;
+
+    m_readBuffer.resize(PNM_STREAM_READ_BUFFER_SIZE);
+    m_frameBytes.resize(PNM_STREAM_MAX_HEADER_SIZE);
+    m_isRunning = true;
+    m_thread = std::thread{&PnmStream::_threadLoop, this};
+    return 0;
+}
+
+size_t PnmStream::_readSome(uint8_t* output, size_t size)
+{
+    while (m_isRunning)
+    {
+        // Wait with a timeout, so the thread can be stopped
+        pollfd pollFd{m_fd, POLLIN, 0};
+        const int pollStatus{poll(&pollFd, 1, PNM_STREAM_POLL_PERIOD_MS)};
+        if (pollStatus < 0 && errno != EINTR)
+        {
+            Logger::err << "Failed to wait for the stream: " << strerror(errno) << Logger::End;
+            return 0;
+        }
+        if (pollStatus <= 0)
+            continue;
+
+        const ssize_t readSize{read(m_fd, output, size)};
+        if (readSize < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            Logger::err << "Failed to read the stream: " << strerror(errno) << Logger::End;
+            return 0;
+        }
+        return size_t(readSize);
+    }
+    return 0;
+}
+
+bool PnmStream::_readHeaderByte(uint8_t* byteOut)
+{
+    if (m_frameSize >= PNM_STREAM_MAX_HEADER_SIZE)
+    {
+        Logger::err << "Header of PNM stream image is too long" << Logger::End;
+        return false;
+    }
+
+    if (m_readStart == m_readEnd)
+    {
+        m_readStart = 0;
+        m_readEnd = _readSome(m_readBuffer.data(), m_readBuffer.size());
+        if (m_readEnd == 0)
+            return false;
+    }
+
+    *byteOut = m_readBuffer[m_readStart++];
+    m_frameBytes[m_frameSize++] = *byteOut;
+    return true;
+}
+
+bool PnmStream::_readHeaderValue(uint32_t* valueOut, bool isLastValue)
+{
+    auto skipComment{[this](uint8_t* byte){ // -> bool
+        while (*byte != '\n' && *byte != '\r')
+        {
+            if (!_readHeaderByte(byte))
+                return false;
+        }
+        return true;
+    }};
+
+    uint8_t currByte{};
+    while (true)
+    {
+        if (!_readHeaderByte(&currByte))
+            return false;
+        if (currByte == '#')
+        {
+            if (!skipComment(&currByte))
+                return false;
+        }
+        else if (s_pnmCharClasses[currByte] != PnmCharClass::Whitespace)
+        {
+            break;
+        }
+    }
+
+    if (s_pnmCharClasses[currByte] != PnmCharClass::Digit)
+        return false;
+    uint64_t value{};
+    while (s_pnmCharClasses[currByte] == PnmCharClass::Digit)
+    {
+        value = value * 10 + (currByte - '0');
+        if (value > -1_u32 || !_readHeaderByte(&currByte))
+            return false;
+    }
+
+    // A single whitespace character separates the last value from the raster
+    if (currByte == '#' && !isLastValue)
+    {
+        if (!skipComment(&currByte))
+            return false;
+    }
+    else if (s_pnmCharClasses[currByte] != PnmCharClass::Whitespace)
+    {
+        return false;
+    }
+
+    *valueOut = uint32_t(value);
+    return true;
+}
+
+bool PnmStream::_readPamHeaderLines()
+{
+    static constexpr char endLine[]{"ENDHDR"};
+
+    uint32_t lineStart{m_frameSize};
+    uint8_t currByte{};
+    while (_readHeaderByte(&currByte))
+    {
+        if (currByte != '\n')
+            continue;
+
+        // The keyword may be indented and followed by whitespace
+        uint32_t keywordStart{lineStart};
+        while (keywordStart < m_frameSize && s_pnmCharClasses[m_frameBytes[keywordStart]] == PnmCharClass::Whitespace)
+            ++keywordStart;
+        uint32_t keywordEnd{keywordStart};
+        while (keywordEnd < m_frameSize && s_pnmCharClasses[m_frameBytes[keywordEnd]] != PnmCharClass::Whitespace)
+            ++keywordEnd;
+        if (keywordEnd - keywordStart == sizeof(endLine) - 1 &&
+            std::memcmp(m_frameBytes.data() + keywordStart, endLine, sizeof(endLine) - 1) == 0)
+            return true;
+
+        lineStart = m_frameSize;
+    }
+    return false;
+}
+
+int PnmStream::_readFrame()
+{
+    // Whitespace between the images is tolerated
+    uint8_t magic[2]{};
+    do
+    {
+        m_frameSize = 0;
+        if (!_readHeaderByte(&magic[0]))
+            return 1;
+    }
+    while (s_pnmCharClasses[magic[0]] == PnmCharClass::Whitespace);
+
+    if (!_readHeaderByte(&magic[1]) || magic[0] != 'P' || magic[1] < '1' || magic[1] > '7')
+    {
+        Logger::err << "Invalid magic bytes in PNM stream" << Logger::End;
+        return 2;
+    }
+    if (magic[1] < '4')
+    {
+        Logger::err << "Plain (ASCII) PNM images can't be streamed, the size of their raster is unknown" << Logger::End;
+        return 2;
+    }
+
+    uint64_t rasterSize{};
+    if (magic[1] == '7')
+    {
+        if (!_readPamHeaderLines())
+        {
+            Logger::err << "Invalid header in PNM stream" << Logger::End;
+            return 2;
+        }
+        PnmImage::PamHeader header{};
+        if (PnmImage::parsePamHeader(m_frameBytes.data(), m_frameSize, &header))
+            return 2;
+        rasterSize = uint64_t(header.widthPx) * header.heightPx * header.depth * (header.maxPixelVal < 256 ? 1 : 2);
+    }
+    else
+    {
+        const bool isBitmap{magic[1] == '4'};
+        uint32_t widthPx{};
+        uint32_t heightPx{};
+        uint32_t maxPixelVal{1};
+        if (!_readHeaderValue(&widthPx, false) ||
+            !_readHeaderValue(&heightPx, isBitmap) ||
+            (!isBitmap && !_readHeaderValue(&maxPixelVal, true)) ||
+            widthPx == 0 || heightPx == 0 || maxPixelVal == 0 || maxPixelVal > 65535)
+        {
+            Logger::err << "Invalid header in PNM stream" << Logger::End;
+            return 2;
+        }
+
+        rasterSize = isBitmap
+            ? (uint64_t(widthPx) + 7) / 8 * heightPx
+            : uint64_t(widthPx) * heightPx * (magic[1] == '6' ? 3 : 1) * (maxPixelVal < 256 ? 1 : 2);
+    }
+    if (m_frameSize + rasterSize > -1_u32)
+    {
+        Logger::err << "Image in PNM stream is too large" << Logger::End;
+        return 2;
+    }
+    if (m_frameBytes.size() < m_frameSize + rasterSize)
+        m_frameBytes.resize(m_frameSize + rasterSize);
+
+    // Take the already buffered bytes, then read the rest directly to the frame
+    uint8_t* output{m_frameBytes.data() + m_frameSize};
+    size_t remainingSize{std::min(size_t(rasterSize), m_readEnd - m_readStart)};
+    std::memcpy(output, m_readBuffer.data() + m_readStart, remainingSize);
+    m_readStart += remainingSize;
+    output += remainingSize;
+    remainingSize = rasterSize - remainingSize;
+    while (remainingSize)
+    {
+        const size_t readSize{_readSome(output, remainingSize)};
+        if (readSize == 0)
+        {
+            if (m_isRunning)
+                Logger::warn << "PNM stream ended in the middle of an image" << Logger::End;
+            return 2;
+        }
+        output += readSize;
+        remainingSize -= readSize;
+    }
+
+    m_frameSize += rasterSize;
+    return 0;
+}
+
+void PnmStream::_threadLoop()
+{
+    while (m_isRunning)
+    {
+        const int readStatus{_readFrame()};
+        if (readStatus == 1)
+            Logger::log << "PNM stream ended" << Logger::End;
+        if (readStatus)
+            break;
+
+        if (m_frameImage.openMemory(m_frameBytes.data(), m_frameSize))
+            break;
+        auto surface{m_surfacePool.get(m_frameImage.getWidthPx(), m_frameImage.getHeightPx())};
+        if (m_frameImage.renderToPixelArray(
+                    surface->getPixels(), m_frameImage.getWidthPx(), m_frameImage.getHeightPx()))
+        {
+            Logger::err << "Failed to decode image of PNM stream" << Logger::End;
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            // The viewer didn't take the previous frame in time
+            if (m_newestFrame)
+                ++m_stats.droppedFrames;
+            m_newestFrame = std::move(surface);
+            ++m_stats.decodedFrames;
+        }
+        m_frameCond.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_hasEnded = true;
+    }
+    m_frameCond.notify_all();
+}
+
+std::shared_ptr<const DecodedImage> PnmStream::waitForFirstFrame()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_frameCond.wait(lock, [this](){ return m_newestFrame || m_hasEnded; });
+    if (m_newestFrame)
+        ++m_stats.shownFrames;
+    return std::move(m_newestFrame);
+}
+
+std::shared_ptr<const DecodedImage> PnmStream::takeFrame()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_newestFrame)
+        ++m_stats.shownFrames;
+    return std::move(m_newestFrame);
+}
+
+PnmStream::Stats PnmStream::getStats()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_stats;
+}
+
+void PnmStream::logStats()
+{
+    const Stats stats{getStats()};
+    Logger::log << "PNM stream: " << stats.decodedFrames << " frames decoded, " <<
+        stats.shownFrames << " shown, " << stats.droppedFrames << " dropped" << Logger::End;
+}
+
+PnmStream::~PnmStream()
+{
+    m_isRunning = false;
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_isFdOwned && m_fd >= 0)
+        close(m_fd);
+}
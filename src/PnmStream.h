@@ -0,0 +1,169 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "PnmImage.h"
+#include "DecodedImage.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// How often the reader thread checks if it should stop while waiting for data
+#define PNM_STREAM_POLL_PERIOD_MS       100
+#define PNM_STREAM_READ_BUFFER_SIZE     (64 * 1024)
+// Longer headers are rejected, so a garbage stream can't fill the memory with a comment
+#define PNM_STREAM_MAX_HEADER_SIZE      4096
+// Number of surfaces kept for reuse when the shown frame is replaced
+#define PNM_STREAM_MAX_FREE_SURFACES    2
+
+/*
+ * Reads binary PNM and PAM images from standard input ("-") or a named pipe,
+ * and decodes them as a live sequence of frames.
+ *
+ * The header of each image is parsed as it arrives, then exactly the bytes of its raster
+ * are read, so images can follow each other directly, like the output of
+ * `ffmpeg -f image2pipe -vcodec ppm`.
+ * Only the newest decoded frame is kept: if the viewer takes frames slower
+ * than they arrive, the ones in between are dropped.
+ * The surfaces of the frames are recycled once the viewer releases them.
+ */
+class PnmStream final
+{
+public:
+    struct Stats
+    {
+        uint64_t decodedFrames{};
+        uint64_t shownFrames{};
+        uint64_t droppedFrames{};
+    };
+
+private:
+    int m_fd{-1};
+    bool m_isFdOwned{};
+    std::thread m_thread;
+    std::atomic<bool> m_isRunning{};
+
+    // Bytes read from the stream, but not consumed yet, used only by the reader thread
+    std::vector<uint8_t> m_readBuffer;
+    size_t m_readStart{};
+    size_t m_readEnd{};
+    // The header and the raster of the current image, used only by the reader thread.
+    // The vector only grows, so it is not reallocated for every frame.
+    std::vector<uint8_t> m_frameBytes;
+    uint32_t m_frameSize{};
+    PnmImage m_frameImage;
+
+    DecodedImagePool m_surfacePool{PNM_STREAM_MAX_FREE_SURFACES};
+
+    std::mutex m_mutex;
+    std::condition_variable m_frameCond;
+    // The newest decoded frame, not taken yet, protected by `m_mutex`
+    std::shared_ptr<const DecodedImage> m_newestFrame;
+    // Set when the reader thread exits, protected by `m_mutex`
+    bool m_hasEnded{};
+    // Protected by `m_mutex`
+    Stats m_stats;
+
+    void _threadLoop();
+    /*
+     * Waits for data and reads at most `size` bytes into `output`.
+     * Returns the number of bytes read, 0 at the end of the stream or if the stream is closed.
+     */
+    size_t _readSome(uint8_t* output, size_t size);
+    /*
+     * Reads one byte of the header and appends it to the frame.
+     * Returns false at the end of the stream.
+     */
+    bool _readHeaderByte(uint8_t* byteOut);
+    /*
+     * Reads an unsigned integer of the header, skipping the whitespace and the comments before it.
+     * The character after the digits is consumed too, it must be whitespace
+     * (or a comment if this is not the last value).
+     */
+    bool _readHeaderValue(uint32_t* valueOut, bool isLastValue);
+    /*
+     * Reads the lines of a PAM header until the ENDHDR line, including its line break.
+     * Returns false at the end of the stream or if the header is too long.
+     */
+    bool _readPamHeaderLines();
+    /*
+     * Reads the header and the raster of the next image to `m_frameBytes`.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      1 at the end of the stream before the next image.
+     *      2 if the image is invalid or truncated.
+     */
+    int _readFrame();
+
+public:
+    PnmStream() {}
+
+    PnmStream(const PnmStream&) = delete;
+    PnmStream& operator=(const PnmStream&) = delete;
+
+    /*
+     * Returns true if `path` is standard input ("-") or a named pipe.
+     */
+    static bool isStreamPath(const std::string& path);
+
+    /*
+     * Opens the stream and starts the reader thread.
+     * Opening a named pipe blocks until a writer opens it too.
+     *
+     * Returns:
+     *      0, if succeded.
+     *      Nonzero if failed.
+     */
+    int open(const std::string& path);
+
+    /*
+     * Blocks until the first frame is decoded.
+     *
+     * Returns:
+     *      The first frame, if succeded.
+     *      nullptr if the stream ended without a valid image.
+     */
+    std::shared_ptr<const DecodedImage> waitForFirstFrame();
+
+    /*
+     * Returns the newest frame decoded since the last call,
+     * or nullptr if there is no new one.
+     */
+    std::shared_ptr<const DecodedImage> takeFrame();
+
+    Stats getStats();
+    void logStats();
+
+    ~PnmStream();
+};
@@ -52,7 +52,7 @@ int SvgImage::open(const std::string &filepath)
 
     m_parser = std::make_unique<XmlParser>(content);
 
-    std::cout << "Found " << m_parser->size() << " elements\n";
+    Logger::log << std::dec << "Found " << m_parser->size() << " elements" << Logger::End;
 
     {
         auto svgElement = m_parser->findFirstElementWithName("svg");
@@ -77,14 +77,16 @@ int SvgImage::open(const std::string &filepath)
 
     Logger::log << "Bitmap size: " << m_bitmapWidthPx << 'x' << m_bitmapHeightPx << " px" << Logger::End;
 
+    m_filePath = filepath;
+    m_isInitialized = true;
     return 0;
 }
 
-int SvgImage::render(
-        SDL_Texture* texture,
+int SvgImage::renderToPixelArray(
+        uint8_t* pixelArray,
         uint32_t viewportWidth, uint32_t viewportHeight) const
 {
-    (void)texture;
+    (void)pixelArray;
     (void)viewportWidth;
     (void)viewportHeight;
 
@@ -39,8 +39,10 @@ private:
 
 public:
     virtual int open(const std::string &filepath) override;
-    virtual int render(
-            SDL_Texture* texture,
+    virtual int renderToPixelArray(
+            uint8_t* pixelArray,
             uint32_t viewportWidth, uint32_t viewportHeight) const override;
+    // Nothing is rasterized yet, the blank surfaces are not worth caching
+    virtual bool isSlowToDecode() const override { return false; }
 
 };
@@ -0,0 +1,229 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "TextureAtlas.h"
+#include "Logger.h"
+#include <algorithm>
+
+int TextureAtlas::_addPage()
+{
+    Page page{};
+    page.texture = SDL_CreateTexture(
+            m_renderer,
+            SDL_PIXELFORMAT_RGBA32,
+            SDL_TEXTUREACCESS_STREAMING,
+            ATLAS_PAGE_SIZE_PX, ATLAS_PAGE_SIZE_PX);
+    if (!page.texture)
+    {
+        Logger::err << "Failed to create atlas page: " << SDL_GetError() << Logger::End;
+        return 1;
+    }
+    SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+
+    m_pages.push_back(std::move(page));
+    Logger::log << std::dec << "Texture atlas: Added page " << m_pages.size() << Logger::End;
+    return 0;
+}
+
+bool TextureAtlas::_allocateInPage(size_t pageI, int width, int height, SDL_Rect* rectOut)
+{
+    Page& page{m_pages[pageI]};
+    const int shelfHeight{(height + ATLAS_SHELF_HEIGHT_STEP - 1) / ATLAS_SHELF_HEIGHT_STEP * ATLAS_SHELF_HEIGHT_STEP};
+
+    // Use the lowest existing shelf that is high enough and has room
+    Shelf* bestShelf{};
+    for (auto& shelf : page.shelves)
+    {
+        if (shelf.height >= shelfHeight && shelf.height <= shelfHeight * 2 &&
+            ATLAS_PAGE_SIZE_PX - shelf.usedWidth >= width &&
+            (!bestShelf || shelf.height < bestShelf->height))
+            bestShelf = &shelf;
+    }
+
+    // Open a new shelf
+    if (!bestShelf)
+    {
+        if (ATLAS_PAGE_SIZE_PX - page.usedHeight < shelfHeight)
+            return false;
+        page.shelves.push_back({page.usedHeight, shelfHeight, 0});
+        page.usedHeight += shelfHeight;
+        bestShelf = &page.shelves.back();
+    }
+
+    *rectOut = {bestShelf->usedWidth, bestShelf->y, width, height};
+    bestShelf->usedWidth += width;
+    return true;
+}
+
+void TextureAtlas::_evictPage(size_t pageI)
+{
+    for (auto it{m_slots.begin()}; it != m_slots.end();)
+    {
+        if (it->second.pageI == pageI)
+        {
+            m_evictedOwners.push_back(it->second.owner);
+            it = m_slots.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    Page& page{m_pages[pageI]};
+    page.shelves.clear();
+    page.usedHeight = 0;
+}
+
+TextureAtlas::slotId_t TextureAtlas::add(const DecodedImage& image, size_t owner)
+{
+    const int width{(int)image.getWidthPx()};
+    const int height{(int)image.getHeightPx()};
+    if (width > ATLAS_PAGE_SIZE_PX || height > ATLAS_PAGE_SIZE_PX)
+        return invalidSlotId;
+
+    SDL_Rect rect{};
+    size_t pageI{};
+    bool isAllocated{};
+    for (; pageI < m_pages.size(); ++pageI)
+    {
+        isAllocated = _allocateInPage(pageI, width, height, &rect);
+        if (isAllocated)
+            break;
+    }
+
+    if (!isAllocated && m_pages.size() < ATLAS_MAX_PAGE_COUNT)
+    {
+        if (_addPage())
+            return invalidSlotId;
+        pageI = m_pages.size() - 1;
+        isAllocated = _allocateInPage(pageI, width, height, &rect);
+    }
+
+    if (!isAllocated)
+    {
+        // All the pages are full, make room by evicting the least recently drawn one
+        pageI = 0;
+        for (size_t i{1}; i < m_pages.size(); ++i)
+        {
+            if (m_pages[i].lastDrawnFrame < m_pages[pageI].lastDrawnFrame)
+                pageI = i;
+        }
+
+        Logger::log << std::dec << "Texture atlas: Evicting page " << pageI + 1 << Logger::End;
+        _evictPage(pageI);
+        isAllocated = _allocateInPage(pageI, width, height, &rect);
+        if (!isAllocated)
+            return invalidSlotId;
+    }
+
+    if (SDL_UpdateTexture(m_pages[pageI].texture, &rect, image.getPixels(), image.getPitch()))
+    {
+        Logger::err << "Failed to update atlas page: " << SDL_GetError() << Logger::End;
+        return invalidSlotId;
+    }
+
+    const slotId_t slotId{m_nextSlotId++};
+    if (m_nextSlotId == invalidSlotId)
+        ++m_nextSlotId;
+    m_slots[slotId] = {pageI, rect, owner};
+    return slotId;
+}
+
+std::vector<size_t> TextureAtlas::takeEvictedOwners()
+{
+    std::vector<size_t> owners;
+    owners.swap(m_evictedOwners);
+    return owners;
+}
+
+void TextureAtlas::queueDraw(slotId_t slotId, const SDL_Rect& dstRect)
+{
+    auto found{m_slots.find(slotId)};
+    if (found == m_slots.end())
+        return;
+
+    Page& page{m_pages[found->second.pageI]};
+    const SDL_Rect& srcRect{found->second.rect};
+    page.lastDrawnFrame = m_frameCounter;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // Two triangles per image
+    const int firstVertexI{(int)page.vertices.size()};
+    const float u1{(float)srcRect.x / ATLAS_PAGE_SIZE_PX};
+    const float v1{(float)srcRect.y / ATLAS_PAGE_SIZE_PX};
+    const float u2{(float)(srcRect.x + srcRect.w) / ATLAS_PAGE_SIZE_PX};
+    const float v2{(float)(srcRect.y + srcRect.h) / ATLAS_PAGE_SIZE_PX};
+    const float x1{(float)dstRect.x};
+    const float y1{(float)dstRect.y};
+    const float x2{(float)(dstRect.x + dstRect.w)};
+    const float y2{(float)(dstRect.y + dstRect.h)};
+    const SDL_Color white{255, 255, 255, 255};
+    page.vertices.push_back({{x1, y1}, white, {u1, v1}});
+    page.vertices.push_back({{x2, y1}, white, {u2, v1}});
+    page.vertices.push_back({{x2, y2}, white, {u2, v2}});
+    page.vertices.push_back({{x1, y2}, white, {u1, v2}});
+    for (int i : {0, 1, 2, 0, 2, 3})
+        page.indices.push_back(firstVertexI + i);
+#else
+    page.copies.push_back({srcRect, dstRect});
+#endif
+}
+
+void TextureAtlas::flushDraws()
+{
+    for (auto& page : m_pages)
+    {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        if (page.vertices.empty())
+            continue;
+
+        SDL_RenderGeometry(
+                m_renderer, page.texture,
+                page.vertices.data(), (int)page.vertices.size(),
+                page.indices.data(), (int)page.indices.size());
+
+        // Keep the capacity, about the same amount is drawn in the next frame
+        page.vertices.clear();
+        page.indices.clear();
+#else
+        // Copies of the same texture in a row are still batched by the renderer
+        for (const auto& copy : page.copies)
+            SDL_RenderCopy(m_renderer, page.texture, &copy.first, &copy.second);
+        page.copies.clear();
+#endif
+    }
+
+    ++m_frameCounter;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (auto& page : m_pages)
+        SDL_DestroyTexture(page.texture);
+}
@@ -0,0 +1,140 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "DecodedImage.h"
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define ATLAS_PAGE_SIZE_PX      2048
+#define ATLAS_MAX_PAGE_COUNT    8
+// Shelf heights are rounded up to this, so similar images share shelves
+#define ATLAS_SHELF_HEIGHT_STEP 8
+
+/*
+ * Packs many small images into a few large streaming textures (pages),
+ * so drawing them needs a few draw calls instead of one per image.
+ *
+ * The images are placed on shelves: horizontal strips of a page.
+ * Only the rectangle of a newly added image is uploaded.
+ * When all the pages are full, the least recently drawn page is evicted as a whole.
+ * The owners of the evicted images are reported by `takeEvictedOwners()`.
+ */
+class TextureAtlas final
+{
+public:
+    using slotId_t = uint32_t;
+    static constexpr slotId_t invalidSlotId{0};
+
+private:
+    struct Shelf
+    {
+        int y{};
+        int height{};
+        int usedWidth{};
+    };
+
+    struct Page
+    {
+        SDL_Texture* texture{};
+        std::vector<Shelf> shelves;
+        int usedHeight{};
+        uint64_t lastDrawnFrame{};
+        // The queued draws
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+#else
+        std::vector<std::pair<SDL_Rect, SDL_Rect>> copies;
+#endif
+    };
+
+    struct Slot
+    {
+        size_t pageI{};
+        SDL_Rect rect{};
+        size_t owner{};
+    };
+
+    SDL_Renderer* m_renderer{};
+    std::vector<Page> m_pages;
+    std::unordered_map<slotId_t, Slot> m_slots;
+    slotId_t m_nextSlotId{invalidSlotId + 1};
+    std::vector<size_t> m_evictedOwners;
+    uint64_t m_frameCounter{};
+
+    bool _allocateInPage(size_t pageI, int width, int height, SDL_Rect* rectOut);
+    int _addPage();
+    void _evictPage(size_t pageI);
+
+public:
+    TextureAtlas(SDL_Renderer* renderer)
+        : m_renderer{renderer}
+    {
+    }
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    /*
+     * Adds an image to the atlas and uploads its pixels.
+     * `owner` is an arbitrary identifier that is reported when the image is evicted.
+     *
+     * Returns:
+     *      The ID of the slot, if succeded.
+     *      `invalidSlotId` if the image does not fit in a page or
+     *      a texture could not be created.
+     */
+    slotId_t add(const DecodedImage& image, size_t owner);
+
+    /*
+     * Returns the owners of the images evicted since the last call.
+     * The slots of these images are invalid.
+     */
+    std::vector<size_t> takeEvictedOwners();
+
+    /*
+     * Queues drawing the image to `dstRect`.
+     * The queued images are drawn by `flushDraws()`.
+     */
+    void queueDraw(slotId_t slotId, const SDL_Rect& dstRect);
+
+    /*
+     * Draws the queued images, with one draw call per page where possible.
+     */
+    void flushDraws();
+
+    inline size_t getPageCount() const { return m_pages.size(); }
+    inline size_t getImageCount() const { return m_slots.size(); }
+
+    ~TextureAtlas();
+};
@@ -0,0 +1,126 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Set in the threads started by the pools
+static thread_local bool s_isWorkerThread{};
+
+ThreadPool::ThreadPool(size_t workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i{}; i < workerCount; ++i)
+        m_workers.emplace_back(&ThreadPool::_workerLoop, this);
+}
+
+void ThreadPool::_workerLoop()
+{
+    s_isWorkerThread = true;
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_taskPostedCond.wait(lock, [this](){ return m_isStopping || m_pendingTaskCount; });
+            if (m_isStopping)
+                return;
+
+            task = std::move(m_tasks[m_taskStart]);
+            m_tasks[m_taskStart] = nullptr;
+            m_taskStart = (m_taskStart + 1) % m_tasks.size();
+            --m_pendingTaskCount;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            if (--m_unfinishedTaskCount == 0)
+                m_allDoneCond.notify_all();
+        }
+    }
+}
+
+void ThreadPool::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_pendingTaskCount == m_tasks.size())
+        {
+            // Grow the ring, keeping the order of the tasks
+            std::vector<std::function<void()>> tasks(std::max<size_t>(THREAD_POOL_MIN_QUEUE_SIZE, m_tasks.size() * 2));
+            for (size_t i{}; i < m_pendingTaskCount; ++i)
+                tasks[i] = std::move(m_tasks[(m_taskStart + i) % m_tasks.size()]);
+            m_tasks = std::move(tasks);
+            m_taskStart = 0;
+        }
+        m_tasks[(m_taskStart + m_pendingTaskCount) % m_tasks.size()] = std::move(task);
+        ++m_pendingTaskCount;
+        ++m_unfinishedTaskCount;
+    }
+    m_taskPostedCond.notify_one();
+}
+
+void ThreadPool::cancelPending()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_unfinishedTaskCount -= m_pendingTaskCount;
+    for (; m_pendingTaskCount; --m_pendingTaskCount)
+    {
+        m_tasks[m_taskStart] = nullptr;
+        m_taskStart = (m_taskStart + 1) % m_tasks.size();
+    }
+    if (m_unfinishedTaskCount == 0)
+        m_allDoneCond.notify_all();
+}
+
+void ThreadPool::waitAll()
+{
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_allDoneCond.wait(lock, [this](){ return m_unfinishedTaskCount == 0; });
+}
+
+bool ThreadPool::isWorkerThread()
+{
+    return s_isWorkerThread;
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_isStopping = true;
+    }
+    m_taskPostedCond.notify_all();
+
+    for (auto& worker : m_workers)
+        worker.join();
+}
@@ -0,0 +1,94 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The task queue starts with room for this many tasks
+#define THREAD_POOL_MIN_QUEUE_SIZE 64
+
+/*
+ * A fixed set of worker threads running tasks in the order they were posted.
+ */
+class ThreadPool final
+{
+private:
+    std::vector<std::thread> m_workers;
+    // A ring buffer of the tasks not started yet. It only grows,
+    // so posting tasks doesn't allocate memory once it is large enough.
+    std::vector<std::function<void()>> m_tasks;
+    size_t m_taskStart{};
+    size_t m_pendingTaskCount{};
+    // Number of tasks that are queued or running
+    size_t m_unfinishedTaskCount{};
+    bool m_isStopping{};
+    std::mutex m_mutex;
+    std::condition_variable m_taskPostedCond;
+    std::condition_variable m_allDoneCond;
+
+    void _workerLoop();
+
+public:
+    /*
+     * Starts `workerCount` threads, or one per CPU core if it is 0.
+     */
+    ThreadPool(size_t workerCount=0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void post(std::function<void()> task);
+
+    /*
+     * Removes the tasks that are not started yet.
+     */
+    void cancelPending();
+
+    /*
+     * Blocks until all the posted tasks are finished.
+     */
+    void waitAll();
+
+    inline size_t getWorkerCount() const { return m_workers.size(); }
+
+    /*
+     * Whether the calling thread is a worker of any pool.
+     * Tasks use it to avoid starting pools of their own on top of the running ones.
+     */
+    static bool isWorkerThread();
+
+    /*
+     * Waits for the running tasks to finish, the pending ones are dropped.
+     */
+    ~ThreadPool();
+};
@@ -0,0 +1,355 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ThumbnailGrid.h"
+#include "ImageLoader.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+
+ThumbnailGrid::ThumbnailGrid(SDL_Renderer* renderer, const std::vector<std::string>& filePaths)
+    : m_renderer{renderer}, m_atlas{renderer}
+{
+    m_items.resize(filePaths.size());
+    for (size_t i{}; i < filePaths.size(); ++i)
+        m_items[i].filePath = filePaths[i];
+
+    Logger::log << std::dec << "Generating " << m_items.size() << " thumbnails on " <<
+        m_threadPool.getWorkerCount() << " threads" << Logger::End;
+
+    // Every task generates the most important thumbnail at the time it runs,
+    // not a fixed one, so the order follows the scrolling
+    for (size_t i{}; i < m_items.size(); ++i)
+        m_threadPool.post([this](){ _generateNextThumbnail(); });
+}
+
+size_t ThumbnailGrid::_pickNextItem()
+{
+    auto isPending{[this](size_t i){ return m_items[i].state == ItemState::Pending; }};
+
+    // The items on the screen
+    for (size_t i{m_firstVisibleItemI}; i <= m_lastVisibleItemI && i < m_items.size(); ++i)
+    {
+        if (isPending(i))
+            return i;
+    }
+
+    // The next screen, where the user is likely to scroll
+    const size_t visibleCount{m_lastVisibleItemI - m_firstVisibleItemI + 1};
+    for (size_t i{m_lastVisibleItemI + 1}; i <= m_lastVisibleItemI + visibleCount && i < m_items.size(); ++i)
+    {
+        if (isPending(i))
+            return i;
+    }
+
+    // Everything else in order
+    while (m_nextBackgroundItemI < m_items.size() && !isPending(m_nextBackgroundItemI))
+        ++m_nextBackgroundItemI;
+    return m_nextBackgroundItemI;
+}
+
+void ThumbnailGrid::_generateNextThumbnail()
+{
+    size_t itemI{};
+    std::string filePath;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        itemI = _pickNextItem();
+        if (itemI >= m_items.size())
+            return;
+        m_items[itemI].state = ItemState::InProgress;
+        filePath = m_items[itemI].filePath;
+    }
+
+    std::shared_ptr<DecodedImage> thumbnail;
+    auto image{createImageForFile(filePath)};
+    if (image && image->open(filePath) == 0)
+        thumbnail = image->decodeThumbnail(THUMBNAIL_SIZE_PX, THUMBNAIL_SIZE_PX);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (thumbnail)
+    {
+        m_items[itemI].thumbnail = std::move(thumbnail);
+        m_items[itemI].state = ItemState::Ready;
+        m_readyItemIs.push_back(itemI);
+    }
+    else
+    {
+        Logger::err << "Failed to generate thumbnail: " << filePath << Logger::End;
+        m_items[itemI].state = ItemState::Failed;
+        ++m_finishedItemCount;
+    }
+}
+
+bool ThumbnailGrid::update()
+{
+    const auto startTime{std::chrono::steady_clock::now()};
+
+    std::vector<size_t> readyItemIs;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        readyItemIs.swap(m_readyItemIs);
+    }
+
+    size_t uploadedCount{};
+    for (; uploadedCount < readyItemIs.size(); ++uploadedCount)
+    {
+        if (std::chrono::steady_clock::now() - startTime > std::chrono::milliseconds{THUMBNAIL_UPLOAD_BUDGET_MS})
+            break;
+
+        Item& item{m_items[readyItemIs[uploadedCount]]};
+        std::shared_ptr<DecodedImage> thumbnail;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            thumbnail = std::move(item.thumbnail);
+        }
+
+        // Evicted thumbnails are counted only the first time
+        const bool isFirstUpload{item.widthPx == 0};
+        item.atlasSlot = m_atlas.add(*thumbnail, readyItemIs[uploadedCount]);
+        item.widthPx = thumbnail->getWidthPx();
+        item.heightPx = thumbnail->getHeightPx();
+
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (isFirstUpload)
+            ++m_finishedItemCount;
+        item.state = item.atlasSlot == TextureAtlas::invalidSlotId ? ItemState::Failed : ItemState::Uploaded;
+    }
+
+    const auto evictedItemIs{m_atlas.takeEvictedOwners()};
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (size_t itemI : evictedItemIs)
+    {
+        m_items[itemI].atlasSlot = TextureAtlas::invalidSlotId;
+        m_items[itemI].state = ItemState::Evicted;
+    }
+
+    // Put back what did not fit in the time budget
+    m_readyItemIs.insert(m_readyItemIs.end(), readyItemIs.begin() + uploadedCount, readyItemIs.end());
+
+    const bool hasChanged{m_finishedItemCount != m_lastUpdateFinishedItemCount};
+    m_lastUpdateFinishedItemCount = m_finishedItemCount;
+    return hasChanged;
+}
+
+int ThumbnailGrid::_getCellSize() const
+{
+    return THUMBNAIL_SIZE_PX + THUMBNAIL_CELL_PADDING_PX * 2;
+}
+
+int ThumbnailGrid::_getColumnCount() const
+{
+    return std::max(1, m_windowWidth / _getCellSize());
+}
+
+void ThumbnailGrid::_updateVisibleRange()
+{
+    const int cellSize{_getCellSize()};
+    const int rowCount{int((m_items.size() + _getColumnCount() - 1) / _getColumnCount())};
+    m_scrollY = std::max(0, std::min(m_scrollY, rowCount * cellSize - m_windowHeight));
+
+    const size_t firstRow{size_t(m_scrollY / cellSize)};
+    const size_t lastRow{size_t((m_scrollY + std::max(1, m_windowHeight) - 1) / cellSize)};
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_firstVisibleItemI = firstRow * _getColumnCount();
+    m_lastVisibleItemI = (lastRow + 1) * _getColumnCount() - 1;
+
+    // Generate the evicted thumbnails again when they are about to be shown.
+    // The rest stay evicted, so the atlas doesn't keep evicting its own content.
+    const size_t visibleCount{m_lastVisibleItemI - m_firstVisibleItemI + 1};
+    for (size_t i{m_firstVisibleItemI}; i <= m_lastVisibleItemI + visibleCount && i < m_items.size(); ++i)
+    {
+        if (m_items[i].state == ItemState::Evicted)
+        {
+            m_items[i].state = ItemState::Pending;
+            // The task may pick another item if the user scrolls away before it runs,
+            // then this one is left to the background order
+            m_nextBackgroundItemI = std::min(m_nextBackgroundItemI, i);
+            m_threadPool.post([this](){ _generateNextThumbnail(); });
+        }
+    }
+}
+
+void ThumbnailGrid::_scrollToSelection()
+{
+    const int cellSize{_getCellSize()};
+    const int selectionTop{int(m_selectedItemI / _getColumnCount()) * cellSize};
+    if (selectionTop < m_scrollY)
+        m_scrollY = selectionTop;
+    else if (selectionTop + cellSize > m_scrollY + m_windowHeight)
+        m_scrollY = selectionTop + cellSize - m_windowHeight;
+    _updateVisibleRange();
+}
+
+void ThumbnailGrid::setWindowSize(int width, int height)
+{
+    m_windowWidth = width;
+    m_windowHeight = height;
+    _scrollToSelection();
+}
+
+void ThumbnailGrid::setSelectedItemI(size_t index)
+{
+    if (m_items.empty())
+        return;
+    m_selectedItemI = std::min(index, m_items.size() - 1);
+    _scrollToSelection();
+}
+
+size_t ThumbnailGrid::getFinishedItemCount()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_finishedItemCount;
+}
+
+bool ThumbnailGrid::handleEvent(const SDL_Event& event)
+{
+    if (m_items.empty())
+        return false;
+
+    if (event.type == SDL_MOUSEWHEEL)
+    {
+        m_scrollY -= event.wheel.y * THUMBNAIL_SCROLL_STEP_PX;
+        _updateVisibleRange();
+        return true;
+    }
+
+    if (event.type != SDL_KEYDOWN)
+        return false;
+
+    const long columnCount{_getColumnCount()};
+    const long pageItemCount{std::max(1, m_windowHeight / _getCellSize()) * columnCount};
+    long newSelectedItemI{(long)m_selectedItemI};
+    switch (event.key.keysym.sym)
+    {
+    case SDLK_LEFT:
+    case SDLK_h:
+        --newSelectedItemI;
+        break;
+
+    case SDLK_RIGHT:
+    case SDLK_l:
+        ++newSelectedItemI;
+        break;
+
+    case SDLK_UP:
+    case SDLK_k:
+        newSelectedItemI -= columnCount;
+        break;
+
+    case SDLK_DOWN:
+    case SDLK_j:
+        newSelectedItemI += columnCount;
+        break;
+
+    case SDLK_PAGEUP:
+        newSelectedItemI -= pageItemCount;
+        break;
+
+    case SDLK_PAGEDOWN:
+        newSelectedItemI += pageItemCount;
+        break;
+
+    case SDLK_HOME:
+        newSelectedItemI = 0;
+        break;
+
+    case SDLK_END:
+        newSelectedItemI = m_items.size() - 1;
+        break;
+
+    default:
+        return false;
+    }
+
+    setSelectedItemI((size_t)std::max(0l, std::min(newSelectedItemI, (long)m_items.size() - 1)));
+    return true;
+}
+
+void ThumbnailGrid::draw()
+{
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 255);
+    SDL_RenderClear(m_renderer);
+
+    const int cellSize{_getCellSize()};
+    const int columnCount{_getColumnCount()};
+    // Center the grid horizontally
+    const int offsetX{std::max(0, (m_windowWidth - columnCount * cellSize) / 2)};
+
+    auto getCellRect{[&](size_t i){
+        return SDL_Rect{
+            offsetX + int(i % columnCount) * cellSize,
+            int(i / columnCount) * cellSize - m_scrollY,
+            cellSize, cellSize};
+    }};
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    for (size_t i{m_firstVisibleItemI}; i <= m_lastVisibleItemI && i < m_items.size(); ++i)
+    {
+        const Item& item{m_items[i]};
+        const SDL_Rect cellRect{getCellRect(i)};
+
+        if (item.atlasSlot != TextureAtlas::invalidSlotId)
+        {
+            const SDL_Rect dstRect{
+                cellRect.x + (cellSize - (int)item.widthPx) / 2,
+                cellRect.y + (cellSize - (int)item.heightPx) / 2,
+                (int)item.widthPx, (int)item.heightPx};
+            m_atlas.queueDraw(item.atlasSlot, dstRect);
+        }
+        else // Placeholder
+        {
+            if (item.state == ItemState::Failed)
+                SDL_SetRenderDrawColor(m_renderer, 96, 32, 32, 255);
+            else
+                SDL_SetRenderDrawColor(m_renderer, 48, 48, 48, 255);
+            const SDL_Rect placeholderRect{
+                cellRect.x + THUMBNAIL_CELL_PADDING_PX, cellRect.y + THUMBNAIL_CELL_PADDING_PX,
+                THUMBNAIL_SIZE_PX, THUMBNAIL_SIZE_PX};
+            SDL_RenderFillRect(m_renderer, &placeholderRect);
+        }
+    }
+
+    // Draw all the thumbnails with a few calls
+    m_atlas.flushDraws();
+
+    if (m_selectedItemI >= m_firstVisibleItemI && m_selectedItemI <= m_lastVisibleItemI)
+    {
+        const SDL_Rect cellRect{getCellRect(m_selectedItemI)};
+        SDL_SetRenderDrawColor(m_renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(m_renderer, &cellRect);
+    }
+}
+
+ThumbnailGrid::~ThumbnailGrid()
+{
+    m_threadPool.cancelPending();
+    m_threadPool.waitAll();
+}
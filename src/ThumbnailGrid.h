@@ -0,0 +1,140 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "DecodedImage.h"
+#include "ThreadPool.h"
+#include "TextureAtlas.h"
+#include <SDL2/SDL.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define THUMBNAIL_SIZE_PX           128
+#define THUMBNAIL_CELL_PADDING_PX   8
+// Time spent with uploading finished thumbnails in a frame,
+// so scrolling stays smooth while the workers are busy
+#define THUMBNAIL_UPLOAD_BUDGET_MS  4
+#define THUMBNAIL_SCROLL_STEP_PX    40
+
+/*
+ * A contact sheet of the images: a grid of thumbnails.
+ *
+ * The thumbnails are generated on a pool of worker threads.
+ * The thumbnails on the screen are generated first, then the ones right below them,
+ * then the rest in order. Cells without a thumbnail show a placeholder.
+ * The thumbnails are stored and drawn using a texture atlas. Thumbnails evicted from
+ * the atlas are generated again when they get close to the screen.
+ */
+class ThumbnailGrid final
+{
+private:
+    enum class ItemState
+    {
+        Pending,
+        InProgress,
+        Ready,      // Generated, waiting for upload
+        Uploaded,
+        Evicted,    // Removed from the atlas, generated again when visible
+        Failed,
+    };
+
+    struct Item
+    {
+        std::string filePath;
+        ItemState state{ItemState::Pending};
+        std::shared_ptr<DecodedImage> thumbnail;
+        TextureAtlas::slotId_t atlasSlot{TextureAtlas::invalidSlotId};
+        uint32_t widthPx{};
+        uint32_t heightPx{};
+    };
+
+    SDL_Renderer* m_renderer{};
+    TextureAtlas m_atlas;
+    int m_windowWidth{};
+    int m_windowHeight{};
+    int m_scrollY{};
+    size_t m_selectedItemI{};
+
+    // Protects the items, the ready list and the visible range
+    std::mutex m_mutex;
+    std::vector<Item> m_items;
+    std::vector<size_t> m_readyItemIs;
+    size_t m_firstVisibleItemI{};
+    size_t m_lastVisibleItemI{};
+    // Items before this are not pending, used when there is nothing to do on the screen
+    size_t m_nextBackgroundItemI{};
+    size_t m_finishedItemCount{};
+    // Used to detect the changes since the last update
+    size_t m_lastUpdateFinishedItemCount{(size_t)-1};
+
+    // Destroyed first, so no task runs when the items are destroyed
+    ThreadPool m_threadPool;
+
+    void _generateNextThumbnail();
+    size_t _pickNextItem();
+    int _getColumnCount() const;
+    int _getCellSize() const;
+    void _updateVisibleRange();
+    void _scrollToSelection();
+
+public:
+    ThumbnailGrid(SDL_Renderer* renderer, const std::vector<std::string>& filePaths);
+
+    ThumbnailGrid(const ThumbnailGrid&) = delete;
+    ThumbnailGrid& operator=(const ThumbnailGrid&) = delete;
+
+    void setWindowSize(int width, int height);
+
+    /*
+     * Handles the navigation keys and the mouse wheel.
+     *
+     * Returns:
+     *      true if the event was handled.
+     */
+    bool handleEvent(const SDL_Event& event);
+
+    /*
+     * Uploads the finished thumbnails to textures.
+     *
+     * Returns:
+     *      true if the grid needs to be redrawn.
+     */
+    bool update();
+
+    void draw();
+
+    inline size_t getSelectedItemI() const { return m_selectedItemI; }
+    void setSelectedItemI(size_t index);
+    size_t getFinishedItemCount();
+    inline size_t getItemCount() const { return m_items.size(); }
+
+    ~ThumbnailGrid();
+};
@@ -33,28 +33,29 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 static void printElementInfo(const XmlElement& element)
 {
+    // Printed as a single log entry, so the lines of other threads don't get in between
     switch (element.getType())
     {
         case XmlElement::Type::OpeningElement:
-            std::cout << "\033[32m";
+            Logger::log << "\033[32m";
             break;
         case XmlElement::Type::ClosingElement:
-            std::cout << "\033[31m";
+            Logger::log << "\033[31m";
             break;
         case XmlElement::Type::Content:
-            std::cout << "\033[34m";
+            Logger::log << "\033[34m";
             break;
         case XmlElement::Type::SelfclosingElement:
-            std::cout << "\033[33m";
+            Logger::log << "\033[33m";
             break;
     }
-    std::cout
+    Logger::log
         << "Name: " << element.getElementName()
         << "\nType: " << element.getTypeStr()
         << "\nAttributes:\n";
     for (auto& attribute : element.attributes())
-        std::cout << '\t' << attribute.first << " = " << attribute.second << '\n';
-    std::cout << "\033[0m\n";
+        Logger::log << '\t' << attribute.first << " = " << attribute.second << '\n';
+    Logger::log << "\033[0m" << Logger::End;
 }
 
 XmlParser::XmlParser(const std::string& document)
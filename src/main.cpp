@@ -26,10 +26,13 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include "BmpImage.h"
-#include "PnmImage.h"
-#include "GifImage.h"
-#include "SvgImage.h"
+#include "ImageLoader.h"
+#include "ImageCache.h"
+#include "DiskCache.h"
+#include "ThumbnailGrid.h"
+#include "LiveReloader.h"
+#include "PnmStream.h"
+#include "ImageSequence.h"
 #include "Logger.h"
 #include "misc.h"
 #include <SDL2/SDL.h>
@@ -38,8 +41,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_video.h>
 #include <memory>
+#include <cmath>
 #include <cstring>
 #include <algorithm>
+#include <string>
+#include <vector>
+#include <filesystem>
 
 #define INITIAL_WINDOW_WIDTH  10
 #define INITIAL_WINDOW_HEIGHT 10
@@ -47,64 +54,209 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MAX_WINDOW_HEIGHT 1000
 #define ZOOM_STEP_PERC 5
 #define MOVE_STEP_PX 10
+// The main loop wakes up at least this often to check the background work
+#define MAIN_LOOP_MAX_WAIT_MS 16
+// Scrubbing an animation jumps this much of its length
+#define ANIMATION_SCRUB_STEP_PERC 10
+// Adjusting the levels changes the width of the window by this much
+#define LEVELS_WIDTH_STEP_PERC 20
+// and moves its center by this much of its width
+#define LEVELS_CENTER_STEP_PERC 10
 
 int main(int argc, char** argv)
 {
-    const bool isTestingMode{argc > 2 && std::strcmp(argv[1], "--test")};
+    bool isTestingMode{};
+    bool showStats{};
+    bool useDiskCache{};
+    bool isGridMode{};
+    bool useLiveReload{true};
+    bool useSequence{};
+    double sequenceFps{IMAGE_SEQUENCE_DEFAULT_FPS};
+    bool keepWideImages{};
+    unsigned long cacheBudgetMib{IMAGE_CACHE_DEFAULT_BUDGET_MIB};
+    unsigned long diskCacheBudgetMib{DISK_CACHE_DEFAULT_BUDGET_MIB};
+    std::vector<std::string> filePaths;
+    bool hasDirectoryArg{};
+
+    /*
+     * Parses the value of a size option given in MiB.
+     */
+    auto parseMibOption{[](const char* value, unsigned long* output){ // -> int
+        char* end{};
+        *output = std::strtoul(value, &end, 10);
+        if (end == value || *end)
+        {
+            Logger::err << "Invalid size: " << value << Logger::End;
+            return 1;
+        }
+        return 0;
+    }};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--test") == 0)
+        {
+            isTestingMode = true;
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            showStats = true;
+        }
+        else if (std::strncmp(argv[i], "--cache-budget=", 15) == 0)
+        {
+            if (parseMibOption(argv[i] + 15, &cacheBudgetMib))
+                return 1;
+        }
+        else if (std::strcmp(argv[i], "--disk-cache") == 0)
+        {
+            useDiskCache = true;
+        }
+        else if (std::strncmp(argv[i], "--disk-cache-budget=", 20) == 0)
+        {
+            if (parseMibOption(argv[i] + 20, &diskCacheBudgetMib))
+                return 1;
+            useDiskCache = true;
+        }
+        else if (std::strcmp(argv[i], "--grid") == 0)
+        {
+            isGridMode = true;
+        }
+        else if (std::strcmp(argv[i], "--no-watch") == 0)
+        {
+            useLiveReload = false;
+        }
+        else if (std::strcmp(argv[i], "--keep-16bit") == 0)
+        {
+            keepWideImages = true;
+        }
+        else if (std::strcmp(argv[i], "--sequence") == 0)
+        {
+            useSequence = true;
+        }
+        else if (std::strncmp(argv[i], "--fps=", 6) == 0)
+        {
+            char* end{};
+            sequenceFps = std::strtod(argv[i] + 6, &end);
+            if (end == argv[i] + 6 || *end || !std::isfinite(sequenceFps) || sequenceFps <= 0)
+            {
+                Logger::err << "Invalid frame rate: " << argv[i] + 6 << Logger::End;
+                return 1;
+            }
+            useSequence = true;
+        }
+        else if (std::filesystem::is_directory(argv[i]))
+        {
+            hasDirectoryArg = true;
+            const auto dirFilePaths{listImageFilesInDirectory(argv[i])};
+            filePaths.insert(filePaths.end(), dirFilePaths.begin(), dirFilePaths.end());
+        }
+        else
+        {
+            filePaths.push_back(argv[i]);
+        }
+    }
+
+    if (filePaths.empty() && hasDirectoryArg)
+    {
+        Logger::err << "No image files found" << Logger::End;
+        return 1;
+    }
 
-    std::string filePath{};
-    if (argc < 2) // If no file given
+    if (filePaths.empty()) // If no file given
     {
         // Open the logo image
 
         std::string parentDir = getExeParentDir();
         if (parentDir.length())
-            filePath = parentDir + "/../img/icon.bmp";
+            filePaths.push_back(parentDir + "/../img/icon.bmp");
         else
             return 1;
     }
-    else // If there is file given
-    {
-        // Open it
-        filePath = argv[1];
-    }
-    std::string fileExtension{filePath.substr(filePath.find_last_of('.')+1)};
-    std::transform(
-            fileExtension.begin(), fileExtension.end(),
-            fileExtension.begin(),
-            [](char c){ return std::tolower(c); });
-
-    std::unique_ptr<Image> image{};
-    if (fileExtension.compare("bmp") == 0)
-    {
-        image = std::make_unique<BmpImage>();
-    }
-    else if (fileExtension.compare("pnm") == 0 ||
-             fileExtension.compare("pbm") == 0 ||
-             fileExtension.compare("pgm") == 0 ||
-             fileExtension.compare("ppm") == 0)
-    {
-      image = std::make_unique<PnmImage>();
-    }
-    else if (fileExtension.compare("gif") == 0)
-    {
-        image = std::make_unique<GifImage>();
-    }
-    else if (fileExtension.compare("svg") == 0)
-    {
-        image = std::make_unique<SvgImage>();
-    }
-    else
-    {
-        Logger::err << "Unknown file extension: " << fileExtension << Logger::End;
-        return 1;
-    }
 
-    int openStatus{image->open(filePath)};
-    if (openStatus)
+    ImageCache imageCache{cacheBudgetMib * 1024 * 1024};
+    DiskCache diskCache{uint64_t(diskCacheBudgetMib) * 1024 * 1024};
+    if (useDiskCache && diskCache.init())
+        useDiskCache = false;
+    DiskCache* const diskCachePtr{useDiskCache ? &diskCache : nullptr};
+    size_t currentFileI{};
+
+    /*
+     * Prints the statistics if they were requested.
+     */
+    auto logStats{[&](){
+        if (!showStats)
+            return;
+        imageCache.logStats();
+        if (useDiskCache)
+            diskCache.logStats();
+    }};
+
+    /*
+     * Opens standard input or a named pipe as a stream of images and waits for its first frame.
+     */
+    auto openStream{[](const std::string& filePath, std::unique_ptr<PnmStream>* streamOut){
+        auto newStream{std::make_unique<PnmStream>()};
+        if (newStream->open(filePath))
+            return std::shared_ptr<const DecodedImage>{};
+        auto firstFrame{newStream->waitForFirstFrame()};
+        *streamOut = std::move(newStream);
+        return firstFrame;
+    }};
+
+    // The samples of the shown image at full depth, if they are kept to adjust its levels
+    std::shared_ptr<const DecodedWideImage> wideImage;
+    // The range of samples shown from black to white
+    double levelsCenter{};
+    double levelsWidth{};
+    std::vector<uint8_t> levelsTable;
+    DecodedImagePool levelsSurfacePool{1};
+
+    /*
+     * Shows the whole range of samples.
+     */
+    auto resetLevels{[&](const DecodedWideImage& samples){
+        levelsCenter = samples.getMaxSampleVal() / 2.0;
+        levelsWidth = samples.getMaxSampleVal();
+    }};
+
+    /*
+     * Maps the samples to 8 bits with the current levels.
+     * Only a table is rebuilt, the file is not decoded again.
+     */
+    auto renderLevels{[&](const DecodedWideImage& samples){
+        DecodedWideImage::buildLevelsTable(levelsCenter, levelsWidth, &levelsTable);
+        auto rendered{levelsSurfacePool.get(samples.getWidthPx(), samples.getHeightPx())};
+        samples.renderToPixelArray(levelsTable, rendered->getPixels());
+        return std::shared_ptr<const DecodedImage>{std::move(rendered)};
+    }};
+
+    /*
+     * Loads file `fileI` to show.
+     * Streams are opened, and the samples are kept at full depth if it was requested and the format has them.
+     */
+    auto loadShownFile{[&](size_t fileI,
+            std::unique_ptr<PnmStream>* streamOut, std::shared_ptr<const DecodedWideImage>* wideImageOut,
+            const Image::passCallback_t& passCallback, std::unique_ptr<Image>* openedImageOut){
+        if (PnmStream::isStreamPath(filePaths[fileI]))
+            return openStream(filePaths[fileI], streamOut);
+        if (keepWideImages && (*wideImageOut = loadWideImage(filePaths[fileI])))
+        {
+            resetLevels(**wideImageOut);
+            return renderLevels(**wideImageOut);
+        }
+        return loadImage(filePaths[fileI], &imageCache, diskCachePtr, passCallback,
+                useLiveReload ? openedImageOut : nullptr);
+    }};
+
+    // The stream of the shown file, if it is standard input or a named pipe
+    std::unique_ptr<PnmStream> stream;
+    // The opened file of the shown image, kept for the live reloader
+    std::unique_ptr<Image> openedImage;
+    std::shared_ptr<const DecodedImage> image{loadShownFile(currentFileI, &stream, &wideImage, {}, &openedImage)};
+    if (!image)
     {
         Logger::err << "Failed to open image, exiting" << Logger::End;
-        return openStatus;
+        return 1;
     }
 
     SDL_Init(SDL_INIT_VIDEO);
@@ -112,7 +264,8 @@ int main(int argc, char** argv)
     auto window{SDL_CreateWindow(
             "LIMG",
             SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-            std::min(image->getWidthPx(), (uint32_t)MAX_WINDOW_WIDTH), std::min(image->getHeightPx(), (uint32_t)MAX_WINDOW_HEIGHT),
+            isGridMode ? MAX_WINDOW_WIDTH : std::min(image->getWidthPx(), (uint32_t)MAX_WINDOW_WIDTH),
+            isGridMode ? MAX_WINDOW_HEIGHT : std::min(image->getHeightPx(), (uint32_t)MAX_WINDOW_HEIGHT),
             SDL_WINDOW_RESIZABLE
     )};
     if (!window)
@@ -133,24 +286,70 @@ int main(int argc, char** argv)
     SDL_SetWindowMinimumSize(window, 10, 10);
     SDL_SetWindowMaximumSize(window, MAX_WINDOW_WIDTH, MAX_WINDOW_HEIGHT);
 
-    SDL_Texture* texture{SDL_CreateTexture(
-            renderer,
-            SDL_PIXELFORMAT_RGBA32,
-            SDL_TEXTUREACCESS_STREAMING,
-            image->getWidthPx(), image->getHeightPx()
-    )};
-    if (!texture)
-    {
-        Logger::err << "Failed to create texture: " << SDL_GetError() << Logger::End;
-        return 1;
-    }
-    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    SDL_Texture* texture{};
+    // The frames of streams are uploaded to this texture, then it is swapped with the shown one
+    SDL_Texture* streamBackTexture{};
+    bool useTransparency{true};
+
+    /*
+     * Uploads an RGBA32 pixel array to the texture.
+     * The texture is recreated if the size of the pixels changed.
+     */
+    auto uploadPixels{[&](const uint8_t* pixels, uint32_t widthPx, uint32_t heightPx, int pitch){ // -> int
+        int textureWidth{};
+        int textureHeight{};
+        if (texture)
+            SDL_QueryTexture(texture, nullptr, nullptr, &textureWidth, &textureHeight);
+
+        if (!texture || (uint32_t)textureWidth != widthPx || (uint32_t)textureHeight != heightPx)
+        {
+            SDL_DestroyTexture(texture);
+            texture = SDL_CreateTexture(
+                    renderer,
+                    SDL_PIXELFORMAT_RGBA32,
+                    SDL_TEXTUREACCESS_STREAMING,
+                    widthPx, heightPx);
+            if (!texture)
+            {
+                Logger::err << "Failed to create texture: " << SDL_GetError() << Logger::End;
+                return 1;
+            }
+            SDL_SetTextureBlendMode(texture, useTransparency ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        }
+
+        if (SDL_UpdateTexture(texture, nullptr, pixels, pitch))
+        {
+            Logger::err << "Failed to update texture: " << SDL_GetError() << Logger::End;
+            return 1;
+        }
+        return 0;
+    }};
+
+    /*
+     * Uploads the current image to the texture.
+     */
+    auto uploadImage{[&](){ // -> int
+        return uploadPixels(image->getPixels(), image->getWidthPx(), image->getHeightPx(), image->getPitch());
+    }};
+
+    /*
+     * Uploads the current image, a new frame of the stream or the image sequence, to the texture that is not shown,
+     * so the upload doesn't have to wait for the renderer to finish with the shown one.
+     */
+    auto uploadStreamFrame{[&](){ // -> int
+        std::swap(texture, streamBackTexture);
+        if (uploadImage())
+            return 1;
+        // The transparency may have been toggled since the texture was shown
+        SDL_SetTextureBlendMode(texture, useTransparency ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+        return 0;
+    }};
 
     if (isTestingMode)
     {
         int windowWidth, windowHeight;
         SDL_GetWindowSize(window, &windowWidth, &windowHeight);
-        int renderStatus{image->render(texture, windowWidth, windowHeight)};
+        int renderStatus{uploadImage()};
         if (renderStatus)
         {
             SDL_DestroyTexture(texture);
@@ -161,33 +360,191 @@ int main(int argc, char** argv)
         }
         SDL_Rect srcRect{0, 0, windowWidth, windowHeight};
         SDL_RenderCopy(renderer, texture, &srcRect, nullptr);
+        SDL_DestroyTexture(texture);
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
+        logStats();
         return renderStatus;
     }
 
     bool isRunning{true};
     bool isRedrawNeeded{};
     bool isFullscreen{};
-    bool useTransparency{true};
     int windowWidth, windowHeight;
     SDL_GetWindowSize(window, &windowWidth, &windowHeight);
-    // Set the initial zoom so that the image fits in the window
-    float zoom = std::min(1.0f, std::min((float)MAX_WINDOW_WIDTH / image->getWidthPx(), (float)MAX_WINDOW_HEIGHT / image->getHeightPx()));
+    float zoom{};
     int viewportX{};
     int viewportY{};
 
-    auto updateWindowTitle{[&window, &image, &zoom](){
-        SDL_SetWindowTitle(window,
-                ("LIMG - " + image->getFilepath() +
-                 " (" + std::to_string(image->getWidthPx()) + 'x' + std::to_string(image->getHeightPx()) + ") [" +
-                 std::to_string((int)std::round(zoom * 100 / ZOOM_STEP_PERC) * ZOOM_STEP_PERC) + "%]").c_str());
+    std::unique_ptr<ThumbnailGrid> grid;
+    // The animation of the shown image, if it is animated
+    std::unique_ptr<GifAnimation> animation{stream ? nullptr : createAnimationForFile(filePaths[currentFileI])};
+
+    /*
+     * Replaces the animation with the one of the current file, if it is animated.
+     */
+    auto reopenAnimation{[&](){
+        if (showStats && animation)
+            animation->logStats();
+        animation = stream ? nullptr : createAnimationForFile(filePaths[currentFileI]);
     }};
-    updateWindowTitle();
 
-    // Render the whole image
-    int renderStatus{image->render(texture, image->getWidthPx(), image->getHeightPx())};
+    // The numbered image sequence the shown file belongs to, if it is played
+    std::unique_ptr<ImageSequence> sequence;
+
+    /*
+     * Replaces the image sequence with the one of the current file, if sequences are played.
+     */
+    auto reopenSequence{[&](){
+        if (showStats && sequence)
+            sequence->logStats();
+        sequence.reset();
+        if (!useSequence || stream || animation)
+            return;
+
+        auto framePaths{listImageSequence(filePaths[currentFileI])};
+        if (framePaths.size() < 2)
+            return;
+        const auto startFrameIt{std::find(framePaths.begin(), framePaths.end(), filePaths[currentFileI])};
+        const size_t startFrameI{startFrameIt == framePaths.end() ? 0 : size_t(startFrameIt - framePaths.begin())};
+        sequence = std::make_unique<ImageSequence>(std::move(framePaths), startFrameI, sequenceFps);
+    }};
+    reopenSequence();
+
+    LiveReloader liveReloader;
+    if (useLiveReload && liveReloader.init())
+        useLiveReload = false;
+    // Streams are not watched, reloading would read their data.
+    // The shown pixels are the 8-bit decode of the opened file, unless levels are applied
+    // or an animation is played, then the first reload renders the whole image.
+    auto watchShownFile{[&](std::unique_ptr<Image> openedImage){
+        if (useLiveReload && !stream && !sequence)
+            liveReloader.watch(filePaths[currentFileI], wideImage || animation ? nullptr : std::move(openedImage), image);
+    }};
+    watchShownFile(std::move(openedImage));
+
+    auto updateWindowTitle{[&](){
+        if (isGridMode && grid)
+        {
+            SDL_SetWindowTitle(window,
+                    ("LIMG - " + std::to_string(grid->getFinishedItemCount()) + '/' +
+                     std::to_string(grid->getItemCount()) + " thumbnails").c_str());
+            return;
+        }
+
+        std::string title{
+                "LIMG - " + filePaths[currentFileI] +
+                " (" + std::to_string(image->getWidthPx()) + 'x' + std::to_string(image->getHeightPx()) + ") [" +
+                std::to_string((int)std::round(zoom * 100 / ZOOM_STEP_PERC) * ZOOM_STEP_PERC) + "%]"};
+        if (animation && animation->isPaused())
+            title += " [frame " + std::to_string(animation->getShownFrameI() + 1) + '/' +
+                std::to_string(animation->getFrameCount()) + ']';
+        if (wideImage)
+            title += " [levels " + std::to_string((int)std::round(levelsCenter - levelsWidth / 2)) + '-' +
+                std::to_string((int)std::round(levelsCenter + levelsWidth / 2)) + '/' +
+                std::to_string(wideImage->getMaxSampleVal()) + ']';
+        if (sequence)
+            title += " [frame " + std::to_string(sequence->getShownFrameI() + 1) + '/' +
+                std::to_string(sequence->getFrameCount()) + ", " +
+                std::to_string((int)std::round(sequence->getDisplayFps())) + " FPS shown, " +
+                std::to_string((int)std::round(sequence->getDecodeFps())) + " FPS decoded]";
+        SDL_SetWindowTitle(window, title.c_str());
+    }};
+
+    /*
+     * Resets the view to the newly loaded image.
+     */
+    auto resetView{[&](){
+        // Set the initial zoom so that the image fits in the window
+        zoom = std::min(1.0f, std::min((float)MAX_WINDOW_WIDTH / image->getWidthPx(), (float)MAX_WINDOW_HEIGHT / image->getHeightPx()));
+        viewportX = 0;
+        viewportY = 0;
+        updateWindowTitle();
+        isRedrawNeeded = true;
+    }};
+    resetView();
+
+    /*
+     * Switches between the grid and the single image view.
+     */
+    auto setGridMode{[&](bool value){
+        isGridMode = value;
+        if (isGridMode)
+        {
+            if (!grid)
+                grid = std::make_unique<ThumbnailGrid>(renderer, filePaths);
+            grid->setWindowSize(windowWidth, windowHeight);
+            grid->setSelectedItemI(currentFileI);
+        }
+        updateWindowTitle();
+        isRedrawNeeded = true;
+    }};
+    setGridMode(isGridMode);
+
+    /*
+     * Shows a partially decoded image, fitted to the window, while it is being loaded.
+     */
+    auto showDecodePass{[&](const uint8_t* pixels, uint32_t widthPx, uint32_t heightPx){
+        if (uploadPixels(pixels, widthPx, heightPx, int(widthPx * 4)))
+            return;
+
+        const float fitZoom{std::min(1.0f, std::min((float)windowWidth / widthPx, (float)windowHeight / heightPx))};
+        const int dstRectWidth{int(widthPx * fitZoom)};
+        const int dstRectHeight{int(heightPx * fitZoom)};
+        const SDL_Rect dstRect{
+            windowWidth / 2 - dstRectWidth / 2,
+            windowHeight / 2 - dstRectHeight / 2,
+            dstRectWidth,
+            dstRectHeight};
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, &dstRect);
+        SDL_RenderPresent(renderer);
+    }};
+
+    /*
+     * Opens the image with the index `newFileI` in the single image view.
+     *
+     * Returns:
+     *      0, if succeded or the image could not be opened.
+     *      Nonzero if the texture could not be updated.
+     */
+    auto switchToImage{[&](size_t newFileI){ // -> int
+        std::unique_ptr<PnmStream> newStream;
+        std::shared_ptr<const DecodedWideImage> newWideImage;
+        std::unique_ptr<Image> newOpenedImage;
+        auto newImage{loadShownFile(newFileI, &newStream, &newWideImage, showDecodePass, &newOpenedImage)};
+        if (!newImage)
+        {
+            Logger::err << "Failed to open image, keeping the current one" << Logger::End;
+            // The texture may contain a pass of the failed image
+            isRedrawNeeded = true;
+            if (uploadImage())
+                return 1;
+            // The animation only uploads the changed parts of its frames,
+            // show the current frame again as a whole on top of the restored texture
+            if (animation)
+                animation->seekToFrame(animation->getShownFrameI());
+            return 0;
+        }
+        image = std::move(newImage);
+        wideImage = std::move(newWideImage);
+        currentFileI = newFileI;
+        if (showStats && stream)
+            stream->logStats();
+        stream = std::move(newStream);
+        reopenAnimation();
+        reopenSequence();
+        watchShownFile(std::move(newOpenedImage));
+        if (uploadImage())
+            return 1;
+        resetView();
+        return 0;
+    }};
+
+    // Upload the whole image
+    int renderStatus{uploadImage()};
     if (renderStatus)
     {
         SDL_DestroyTexture(texture);
@@ -199,9 +556,28 @@ int main(int argc, char** argv)
 
     while (isRunning)
     {
+        // Sleep until an event arrives or the next animation frame is due
+        int waitMs{MAIN_LOOP_MAX_WAIT_MS};
+        if (animation && !isGridMode)
+        {
+            const int untilNextFrameMs{animation->getMsUntilNextFrame()};
+            if (untilNextFrameMs >= 0)
+                waitMs = std::min(waitMs, untilNextFrameMs);
+        }
+        if (sequence && !isGridMode)
+            waitMs = std::min(waitMs, sequence->getMsUntilNextFrame());
+
         SDL_Event event;
-        while (isRunning && SDL_PollEvent(&event))
+        for (bool hasEvent{SDL_WaitEventTimeout(&event, waitMs) == 1};
+             isRunning && hasEvent;
+             hasEvent = SDL_PollEvent(&event))
         {
+            if (isGridMode && grid->handleEvent(event))
+            {
+                isRedrawNeeded = true;
+                continue;
+            }
+
             switch (event.type)
             {
             case SDL_QUIT:
@@ -228,6 +604,39 @@ int main(int argc, char** argv)
                     SDL_SetTextureBlendMode(texture, useTransparency ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
                     isRedrawNeeded = true;
                     break;
+
+                case SDLK_n: // Next image
+                case SDLK_p: // Previous image
+                {
+                    if (isGridMode || filePaths.size() < 2)
+                        break;
+
+                    const size_t newFileI{event.key.keysym.sym == SDLK_n
+                        ? (currentFileI + 1) % filePaths.size()
+                        : (currentFileI + filePaths.size() - 1) % filePaths.size()};
+                    if (switchToImage(newFileI))
+                        isRunning = false;
+                    break;
+                }
+
+                case SDLK_g: // Toggle grid view
+                    setGridMode(!isGridMode);
+                    break;
+
+                case SDLK_SPACE: // Pause or resume the animation
+                    if (isGridMode || !animation)
+                        break;
+                    animation->setPaused(!animation->isPaused());
+                    updateWindowTitle();
+                    break;
+
+                case SDLK_RETURN: // Open the selected image of the grid
+                    if (!isGridMode)
+                        break;
+                    setGridMode(false);
+                    if (switchToImage(grid->getSelectedItemI()))
+                        isRunning = false;
+                    break;
                 }
                 break;
 
@@ -250,6 +659,56 @@ int main(int argc, char** argv)
                     isRedrawNeeded = true;
                     break;
 
+                case SDLK_PERIOD: // Step the animation forward
+                case SDLK_COMMA: // Step the animation backward
+                    if (isGridMode || !animation)
+                        break;
+                    animation->setPaused(true);
+                    animation->stepFrames(event.key.keysym.sym == SDLK_PERIOD ? 1 : -1);
+                    break;
+
+                case SDLK_RIGHTBRACKET: // Scrub the animation forward
+                case SDLK_LEFTBRACKET: // Scrub the animation backward
+                {
+                    if (isGridMode || !animation)
+                        break;
+                    const long step{std::max(1l, long(animation->getFrameCount() * ANIMATION_SCRUB_STEP_PERC / 100))};
+                    animation->stepFrames(event.key.keysym.sym == SDLK_RIGHTBRACKET ? step : -step);
+                    break;
+                }
+
+                case SDLK_1: // Narrow the levels
+                case SDLK_2: // Widen the levels
+                case SDLK_3: // Lower the levels
+                case SDLK_4: // Raise the levels
+                case SDLK_0: // Reset the levels
+                    if (isGridMode || !wideImage)
+                        break;
+                    switch (event.key.keysym.sym)
+                    {
+                    case SDLK_1:
+                        levelsWidth = std::max(1.0, levelsWidth * (100 - LEVELS_WIDTH_STEP_PERC) / 100);
+                        break;
+                    case SDLK_2:
+                        levelsWidth = levelsWidth * (100 + LEVELS_WIDTH_STEP_PERC) / 100;
+                        break;
+                    case SDLK_3:
+                        levelsCenter -= levelsWidth * LEVELS_CENTER_STEP_PERC / 100;
+                        break;
+                    case SDLK_4:
+                        levelsCenter += levelsWidth * LEVELS_CENTER_STEP_PERC / 100;
+                        break;
+                    default:
+                        resetLevels(*wideImage);
+                        break;
+                    }
+                    image = renderLevels(*wideImage);
+                    if (uploadImage())
+                        isRunning = false;
+                    updateWindowTitle();
+                    isRedrawNeeded = true;
+                    break;
+
                 case SDLK_h: // Go left
                     viewportX -= MOVE_STEP_PX;
                     isRedrawNeeded = true;
@@ -278,6 +737,8 @@ int main(int argc, char** argv)
                 case SDL_WINDOWEVENT_SIZE_CHANGED:
                     windowWidth = event.window.data1;
                     windowHeight = event.window.data2;
+                    if (grid)
+                        grid->setWindowSize(windowWidth, windowHeight);
                     //Logger::log << std::dec << "Window size changed to " << windowWidth << 'x' << windowHeight << Logger::End;
                     [[fallthrough]];
                 case SDL_WINDOWEVENT_SHOWN:
@@ -293,8 +754,99 @@ int main(int argc, char** argv)
         }
         if (!isRunning)
             break;
-        
-        if (isRedrawNeeded)
+
+        if (useLiveReload && !stream && !sequence)
+        {
+            if (auto reloadedImage{liveReloader.takeReloadedImage()})
+            {
+                // Keep the levels for the new version
+                if (wideImage)
+                {
+                    wideImage = loadWideImage(filePaths[currentFileI]);
+                    if (wideImage)
+                        reloadedImage = renderLevels(*wideImage);
+                    updateWindowTitle();
+                }
+                const bool hasSizeChanged{
+                    reloadedImage->getWidthPx() != image->getWidthPx() ||
+                    reloadedImage->getHeightPx() != image->getHeightPx()};
+                image = std::move(reloadedImage);
+                if (uploadImage())
+                    break;
+                if (hasSizeChanged)
+                    resetView();
+                else
+                    isRedrawNeeded = true;
+                // The new version may have other frames
+                reopenAnimation();
+            }
+        }
+
+        if (stream && !isGridMode)
+        {
+            if (auto frame{stream->takeFrame()})
+            {
+                const bool hasSizeChanged{
+                    frame->getWidthPx() != image->getWidthPx() ||
+                    frame->getHeightPx() != image->getHeightPx()};
+                image = std::move(frame);
+                if (uploadStreamFrame())
+                    break;
+                if (hasSizeChanged)
+                    resetView();
+                else
+                    isRedrawNeeded = true;
+            }
+        }
+
+        if (sequence && !isGridMode)
+        {
+            if (auto frame{sequence->takeFrameToShow()})
+            {
+                const bool hasSizeChanged{
+                    frame->getWidthPx() != image->getWidthPx() ||
+                    frame->getHeightPx() != image->getHeightPx()};
+                image = std::move(frame);
+                if (uploadStreamFrame())
+                    break;
+                if (hasSizeChanged)
+                    resetView();
+                else
+                    isRedrawNeeded = true;
+            }
+            if (sequence->updateRates())
+                updateWindowTitle();
+        }
+
+        if (animation && !isGridMode)
+        {
+            if (animation->takeFrameToShow())
+            {
+                // Only the changed part of the frame is uploaded
+                animation->uploadTakenFrame(texture);
+                animation->finishFrame();
+                if (animation->isPaused())
+                    updateWindowTitle();
+                isRedrawNeeded = true;
+            }
+        }
+
+        bool hasDrawn{};
+        if (isGridMode)
+        {
+            if (grid->update())
+            {
+                updateWindowTitle();
+                isRedrawNeeded = true;
+            }
+            if (isRedrawNeeded)
+            {
+                grid->draw();
+                isRedrawNeeded = false;
+                hasDrawn = true;
+            }
+        }
+        else if (isRedrawNeeded)
         {
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
             SDL_RenderClear(renderer);
@@ -310,17 +862,31 @@ int main(int argc, char** argv)
             if (SDL_RenderCopy(renderer, texture, nullptr, &dstRect))
                 Logger::err << "Failed to copy texture: " << SDL_GetError() << Logger::End;
             isRedrawNeeded = false;
+            hasDrawn = true;
         }
 
-        SDL_RenderPresent(renderer);
-        SDL_Delay(16);
+        if (hasDrawn)
+            SDL_RenderPresent(renderer);
     }
 
+    if (showStats && animation)
+        animation->logStats();
+    if (showStats && stream)
+        stream->logStats();
+    if (showStats && sequence)
+        sequence->logStats();
+    animation.reset();
+    stream.reset();
+    sequence.reset();
+    grid.reset();
     SDL_DestroyTexture(texture);
+    SDL_DestroyTexture(streamBackTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
+    logStats();
+
     Logger::log << "End" << Logger::End;
 
     return 0;
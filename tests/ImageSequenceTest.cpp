@@ -0,0 +1,166 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Plays generated PPM frames as an image sequence and checks the frames
+ * it shows and its counts of decoded, shown, dropped and failed frames.
+ */
+
+#include "TestImage.h"
+#include "../src/ImageSequence.h"
+#include <stdlib.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#define TEST_FRAME_COUNT    6
+// This frame is a broken file
+#define TEST_BROKEN_FRAME_I 2
+#define TEST_FRAME_SIZE_PX  8
+
+/*
+ * The value of every sample of frame `frameI`, so a shown frame tells which file it was decoded from.
+ */
+static uint8_t getFrameSampleVal(size_t frameI)
+{
+    return uint8_t(frameI * 10 + 5);
+}
+
+static std::vector<std::string> writeFrames(const std::string& dirPath)
+{
+    std::vector<std::string> framePaths;
+    for (size_t frameI{}; frameI < TEST_FRAME_COUNT; ++frameI)
+    {
+        framePaths.push_back(dirPath + "/frame_" + std::to_string(frameI) + ".ppm");
+        std::ofstream file{framePaths.back(), std::ios::binary};
+        if (frameI == TEST_BROKEN_FRAME_I)
+        {
+            file << "P6\n";
+            continue;
+        }
+        file << "P6\n" << TEST_FRAME_SIZE_PX << ' ' << TEST_FRAME_SIZE_PX << "\n255\n";
+        file << std::string(TEST_FRAME_SIZE_PX * TEST_FRAME_SIZE_PX * 3, char(getFrameSampleVal(frameI)));
+    }
+    return framePaths;
+}
+
+/*
+ * Plays the sequence for `durationMs` like the viewer does, calling `frameCallback`
+ * with every shown frame and the index of the file it should come from.
+ *
+ * Returns:
+ *      The number of frames shown.
+ */
+template <typename Func>
+static uint64_t play(ImageSequence* sequence, int durationMs, Func frameCallback)
+{
+    uint64_t shownCount{};
+    const auto end{std::chrono::steady_clock::now() + std::chrono::milliseconds{durationMs}};
+    while (std::chrono::steady_clock::now() < end)
+    {
+        if (auto frame{sequence->takeFrameToShow()})
+        {
+            ++shownCount;
+            frameCallback(*frame, sequence->getShownFrameI());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{sequence->getMsUntilNextFrame()});
+    }
+    return shownCount;
+}
+
+int main()
+{
+    char dirPathTemplate[]{"/tmp/limg-sequence-test-XXXXXX"};
+    if (!mkdtemp(dirPathTemplate))
+    {
+        Logger::err << "Failed to create temporary directory" << Logger::End;
+        return 1;
+    }
+    const std::string dirPath{dirPathTemplate};
+    const std::vector<std::string> framePaths{writeFrames(dirPath)};
+
+    int failureCount{};
+    auto check{[&](bool isOk, const std::string& what){
+        if (!isOk)
+        {
+            Logger::err << what << Logger::End;
+            ++failureCount;
+        }
+    }};
+    auto checkFrame{[&](const DecodedImage& frame, size_t frameI){
+        check(frameI != TEST_BROKEN_FRAME_I, "The broken frame was shown");
+        check(frame.getWidthPx() == TEST_FRAME_SIZE_PX && frame.getHeightPx() == TEST_FRAME_SIZE_PX &&
+                frame.getPixels()[0] == getFrameSampleVal(frameI) &&
+                frame.getPixels()[frame.getSizeInBytes() - 2] == getFrameSampleVal(frameI),
+                "Shown frame doesn't match its file: " + std::to_string(frameI));
+    }};
+
+    // Slow enough to decode every frame in time: all the frames are shown in order,
+    // starting from the start frame and looping, except the broken one
+    {
+        ImageSequence sequence{framePaths, 4, 50};
+        size_t expectedFrameI{4};
+        const uint64_t shownCount{play(&sequence, 600, [&](const DecodedImage& frame, size_t frameI){
+            check(frameI == expectedFrameI, "Frame " + std::to_string(frameI) +
+                    " shown instead of " + std::to_string(expectedFrameI));
+            checkFrame(frame, frameI);
+            expectedFrameI = (frameI + 1) % TEST_FRAME_COUNT;
+            if (expectedFrameI == TEST_BROKEN_FRAME_I)
+                expectedFrameI = (expectedFrameI + 1) % TEST_FRAME_COUNT;
+        })};
+
+        const ImageSequence::Stats stats{sequence.getStats()};
+        check(shownCount >= TEST_FRAME_COUNT, "Too few frames shown: " + std::to_string(shownCount));
+        check(stats.shownFrames == shownCount, "Wrong shown frame count");
+        check(stats.droppedFrames == 0, "Frames dropped at a low frame rate: " + std::to_string(stats.droppedFrames));
+        check(stats.failedFrames >= 1, "The broken frame didn't fail");
+        check(stats.decodedFrames >= stats.shownFrames &&
+                stats.decodedFrames <= stats.shownFrames + IMAGE_SEQUENCE_RING_SIZE,
+                "Wrong decoded frame count: " + std::to_string(stats.decodedFrames));
+    }
+
+    // Far faster than a frame can be shown: most frames are dropped,
+    // the shown ones still come from the right files
+    {
+        ImageSequence sequence{framePaths, 0, 10000};
+        const uint64_t shownCount{play(&sequence, 300, checkFrame)};
+
+        const ImageSequence::Stats stats{sequence.getStats()};
+        check(shownCount > 0, "No frames shown at a high frame rate");
+        check(stats.shownFrames == shownCount, "Wrong shown frame count");
+        check(stats.droppedFrames > stats.shownFrames,
+                "Too few frames dropped at a high frame rate: " + std::to_string(stats.droppedFrames));
+        // A decoded frame is shown, dropped or still waiting in the ring
+        check(stats.decodedFrames >= stats.shownFrames &&
+                stats.decodedFrames <= stats.shownFrames + stats.droppedFrames + IMAGE_SEQUENCE_RING_SIZE,
+                "Wrong decoded frame count: " + std::to_string(stats.decodedFrames));
+    }
+
+    std::filesystem::remove_all(dirPath);
+    return reportTestResult(failureCount, "Image sequences played correctly");
+}
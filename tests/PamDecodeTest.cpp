@@ -0,0 +1,191 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Checks the parsing of PAM headers, the decoding of PAM images,
+ * and that the samples mapped through the default levels window are
+ * identical to the 8-bit decode of the same file.
+ */
+
+#include "TestImage.h"
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Generates a binary image with random samples: a PGM (P5) or PPM (P6) image
+ * if `depth` is 0, a PAM (P7) image with `depth` samples per pixel otherwise.
+ */
+static TestImage makeBinaryImage(char type, uint32_t depth, uint32_t widthPx, uint32_t heightPx,
+        uint32_t maxPixelVal, std::mt19937* rng)
+{
+    static const char* tupleTypes[]{"", "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA"};
+
+    TestImage image{startTestImage(type, widthPx, heightPx, maxPixelVal)};
+    std::string text{'P', type};
+    if (type == '7')
+    {
+        image.name += " depth " + std::to_string(depth);
+        text += "\n# generated\nWIDTH " + std::to_string(widthPx) + "\nHEIGHT " + std::to_string(heightPx) +
+            "\nDEPTH " + std::to_string(depth) + "\nMAXVAL " + std::to_string(maxPixelVal) +
+            "\nTUPLTYPE " + tupleTypes[depth] + "\nENDHDR\n";
+    }
+    else
+    {
+        depth = type == '6' ? 3 : 1;
+        text += '\n' + std::to_string(widthPx) + ' ' + std::to_string(heightPx) + '\n' + std::to_string(maxPixelVal) + '\n';
+    }
+    image.data.assign(text.begin(), text.end());
+
+    const bool hasAlpha{depth == 2 || depth == 4};
+    const uint32_t colorSampleCount{hasAlpha ? depth - 1 : depth};
+    for (uint64_t pixelI{}; pixelI < uint64_t(widthPx) * heightPx; ++pixelI)
+    {
+        uint8_t pixel[4]{0, 0, 0, 255};
+        for (uint32_t sampleI{}; sampleI < depth; ++sampleI)
+        {
+            const uint32_t value{uint32_t((*rng)() % (maxPixelVal + 1))};
+            if (maxPixelVal > 255)
+                image.data.push_back(uint8_t(value >> 8));
+            image.data.push_back(uint8_t(value));
+
+            if (sampleI == colorSampleCount)
+                pixel[3] = scaleTestSample(value, maxPixelVal);
+            else if (colorSampleCount == 1)
+                pixel[0] = pixel[1] = pixel[2] = scaleTestSample(value, maxPixelVal);
+            else
+                pixel[sampleI] = scaleTestSample(value, maxPixelVal);
+        }
+        image.expectedPixels.insert(image.expectedPixels.end(), pixel, pixel + 4);
+    }
+    return image;
+}
+
+/*
+ * Returns true if `parsePamHeader()` accepts `text`, filling `headerOut`.
+ */
+static bool parseHeader(const std::string& text, PnmImage::PamHeader* headerOut)
+{
+    return PnmImage::parsePamHeader((const uint8_t*)text.data(), uint32_t(text.size()), headerOut) == 0;
+}
+
+static int testHeaders()
+{
+    int failureCount{};
+    auto check{[&](bool isOk, const char* name){
+        if (!isOk)
+        {
+            Logger::err << "PAM header test failed: " << name << Logger::End;
+            ++failureCount;
+        }
+    }};
+
+    PnmImage::PamHeader header{};
+    const std::string valid{"P7\n# comment\n  WIDTH 3 \nHEIGHT\t2\nDEPTH 4\nMAXVAL 1000\nTUPLTYPE RGB_ALPHA\nENDHDR\n"};
+    check(parseHeader(valid + "raster", &header) && header.widthPx == 3 && header.heightPx == 2 &&
+            header.depth == 4 && header.maxPixelVal == 1000 && header.tupleType == "RGB_ALPHA" &&
+            header.headerEndOffset == valid.size(), "valid header");
+
+    check(parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 2\nMAXVAL 255\nTUPLTYPE GRAYSCALE\nTUPLTYPE _ALPHA\nENDHDR\n", &header) &&
+            header.tupleType == "GRAYSCALE _ALPHA", "tuple type continued on a second line");
+
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n", &header),
+            "tuple type with more samples than the depth");
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 1\nMAXVAL 255\nTUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n", &header),
+            "tuple type with less samples than the depth");
+
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\n", &header),
+            "missing ENDHDR");
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nENDHDR", &header),
+            "ENDHDR without a line break");
+
+    check(parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nTUPLTYPE CMY\nENDHDR\n", &header) &&
+            header.depth == 3 && header.tupleType == "CMY", "unknown tuple type interpreted by the depth");
+    check(parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 1\nMAXVAL 255\nENDHDR\n", &header) && header.depth == 1,
+            "missing tuple type");
+
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 5\nMAXVAL 255\nENDHDR\n", &header), "depth over 4");
+    check(!parseHeader("P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 65536\nENDHDR\n", &header), "maxval over 65535");
+    check(!parseHeader("P7\nWIDTH 1\nDEPTH 3\nMAXVAL 255\nENDHDR\n", &header), "missing height");
+    check(!parseHeader("P7\nWIDTH -1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nENDHDR\n", &header), "negative width");
+
+    return failureCount;
+}
+
+int main()
+{
+    int failureCount{testHeaders()};
+
+    std::mt19937 rng{50};
+    std::vector<TestImage> images;
+    for (uint32_t maxPixelVal : {1u, 255u, 1000u, 65535u})
+    {
+        for (uint32_t depth{1}; depth <= 4; ++depth)
+            images.push_back(makeBinaryImage('7', depth, 29, 7, maxPixelVal, &rng));
+        images.push_back(makeBinaryImage('5', 0, 29, 7, maxPixelVal, &rng));
+        images.push_back(makeBinaryImage('6', 0, 29, 7, maxPixelVal, &rng));
+    }
+
+    for (const TestImage& testImage : images)
+    {
+        PnmImage image;
+        if (openTestImage(testImage, &image))
+        {
+            Logger::err << "Failed to open: " << testImage.name << Logger::End;
+            ++failureCount;
+            continue;
+        }
+
+        auto decoded{image.decode()};
+        if (!decoded || !checkPixels(testImage, "Wrong pixels decoded",
+                    decoded->getPixels(), decoded->getSizeInBytes(), testImage.expectedPixels))
+        {
+            ++failureCount;
+            continue;
+        }
+
+        // The default window maps the whole sample range, like the 8-bit decode
+        auto wide{image.decodeWide()};
+        if (!wide)
+        {
+            Logger::err << "Failed to decode the samples: " << testImage.name << Logger::End;
+            ++failureCount;
+            continue;
+        }
+        std::vector<uint8_t> levelsTable;
+        DecodedWideImage::buildLevelsTable(wide->getMaxSampleVal() / 2.0, wide->getMaxSampleVal(), &levelsTable);
+        std::vector<uint8_t> leveledPixels(decoded->getSizeInBytes());
+        wide->renderToPixelArray(levelsTable, leveledPixels.data());
+        if (!checkPixels(testImage, "The default levels differ from the 8-bit decode",
+                    decoded->getPixels(), decoded->getSizeInBytes(), leveledPixels))
+            ++failureCount;
+    }
+
+    return reportTestResult(failureCount,
+            "All PAM headers parsed and " + std::to_string(images.size()) + " images decoded correctly");
+}
@@ -0,0 +1,135 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Decodes plain (ASCII) PNM images on several threads at once and checks that
+ * the pixels are identical to the ones decoded on a single thread,
+ * which are checked against the samples the images were generated from.
+ */
+
+#include "TestImage.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define TEST_THREAD_COUNT 8
+#define TEST_ROUND_COUNT 3
+
+/*
+ * Generates a plain PBM (P1), PGM (P2) or PPM (P3) image with random samples,
+ * separated by varying whitespace and comments.
+ */
+static TestImage makePlainImage(char type, uint32_t widthPx, uint32_t heightPx, uint32_t maxPixelVal, std::mt19937* rng)
+{
+    TestImage image{startTestImage(type, widthPx, heightPx, maxPixelVal)};
+    std::string text{std::string{'P', type} + "\n# generated\n" + std::to_string(widthPx) + ' ' + std::to_string(heightPx) + '\n'};
+    if (type != '1')
+        text += std::to_string(maxPixelVal) + '\n';
+
+    const uint32_t samplesPerPixel{type == '3' ? 3u : 1u};
+    const uint32_t sampleMax{type == '1' ? 1 : maxPixelVal};
+    static const char* separators[]{" ", "  ", "\n", "\t", " \n# comment 123\n", "\r\n"};
+    for (uint64_t pixelI{}; pixelI < uint64_t(widthPx) * heightPx; ++pixelI)
+    {
+        uint8_t pixel[4]{0, 0, 0, 255};
+        for (uint32_t sampleI{}; sampleI < samplesPerPixel; ++sampleI)
+        {
+            const uint32_t value{uint32_t((*rng)() % (sampleMax + 1))};
+            // The digits of plain bitmaps don't have to be separated
+            if (type != '1' || (*rng)() % 2)
+                text += separators[(*rng)() % std::size(separators)];
+            text += std::to_string(value);
+
+            if (type == '1')
+                pixel[0] = pixel[1] = pixel[2] = value ? 0 : 255;
+            else if (type == '2')
+                pixel[0] = pixel[1] = pixel[2] = scaleTestSample(value, maxPixelVal);
+            else
+                pixel[sampleI] = scaleTestSample(value, maxPixelVal);
+        }
+        image.expectedPixels.insert(image.expectedPixels.end(), pixel, pixel + 4);
+    }
+    text += '\n';
+
+    image.data.assign(text.begin(), text.end());
+    return image;
+}
+
+int main()
+{
+    std::mt19937 rng{44};
+    std::vector<TestImage> images;
+    for (char type : {'1', '2', '3'})
+    {
+        for (uint32_t maxPixelVal : {1u, 255u, 1000u, 65535u})
+        {
+            if (type == '1' && maxPixelVal != 1)
+                continue;
+            images.push_back(makePlainImage(type, 1, 1, maxPixelVal, &rng));
+            images.push_back(makePlainImage(type, 37, 11, maxPixelVal, &rng));
+            images.push_back(makePlainImage(type, 200, 64, maxPixelVal, &rng));
+        }
+    }
+    // Large enough to be parsed in chunks on multiple threads
+    images.push_back(makePlainImage('3', 600, 1000, 1000, &rng));
+
+    int failureCount{};
+    std::vector<std::vector<uint8_t>> singleThreadPixels;
+    for (const TestImage& image : images)
+    {
+        singleThreadPixels.push_back(decodeTestImage(image));
+        const std::vector<uint8_t>& pixels{singleThreadPixels.back()};
+        if (!checkPixels(image, "Wrong pixels decoded on a single thread", pixels.data(), pixels.size(), image.expectedPixels))
+            ++failureCount;
+    }
+
+    std::atomic<int> mismatchCount{};
+    std::vector<std::thread> threads;
+    for (size_t threadI{}; threadI < TEST_THREAD_COUNT; ++threadI)
+    {
+        threads.emplace_back([&, threadI](){
+            // Every thread goes through the images in a different order
+            for (size_t i{}; i < images.size() * TEST_ROUND_COUNT; ++i)
+            {
+                const size_t imageI{(i + threadI * 5) % images.size()};
+                const std::vector<uint8_t> pixels{decodeTestImage(images[imageI])};
+                if (!checkPixels(images[imageI], "Pixels decoded concurrently differ",
+                            pixels.data(), pixels.size(), singleThreadPixels[imageI]))
+                    ++mismatchCount;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    failureCount += mismatchCount;
+
+    return reportTestResult(failureCount, "All " + std::to_string(images.size()) +
+            " images decoded identically on " + std::to_string(TEST_THREAD_COUNT) + " threads");
+}
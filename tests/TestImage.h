@@ -0,0 +1,132 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2021, timre13
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+/*
+ * The fixture shared by the PNM decoding tests: generated images with the
+ * pixels they should decode to, and the checks run on the decoded pixels.
+ */
+
+#include "../src/PnmImage.h"
+#include "../src/Logger.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct TestImage
+{
+    std::string name;
+    std::vector<uint8_t> data;
+    uint32_t widthPx{};
+    uint32_t heightPx{};
+    // The RGBA pixels the image should be decoded to
+    std::vector<uint8_t> expectedPixels;
+};
+
+/*
+ * Creates an empty test image of PNM type `type` ('1' to '7'), named after its parameters.
+ * The generators append the file data and the expected pixels.
+ */
+inline TestImage startTestImage(char type, uint32_t widthPx, uint32_t heightPx, uint32_t maxPixelVal)
+{
+    TestImage image;
+    image.name = std::string{'P', type} + ' ' + std::to_string(widthPx) + 'x' + std::to_string(heightPx) +
+        " max " + std::to_string(maxPixelVal);
+    image.widthPx = widthPx;
+    image.heightPx = heightPx;
+    return image;
+}
+
+/*
+ * Scales a sample to 8 bits, rounding to the nearest value like the decoder.
+ */
+inline uint8_t scaleTestSample(uint32_t value, uint32_t maxPixelVal)
+{
+    return uint8_t((value * 255 + maxPixelVal / 2) / maxPixelVal);
+}
+
+/*
+ * Opens the test image through `PnmImage::openMemory()`.
+ *
+ * Returns:
+ *      0, if succeded.
+ *      Nonzero if failed.
+ */
+inline int openTestImage(const TestImage& testImage, PnmImage* imageOut)
+{
+    return imageOut->openMemory(testImage.data.data(), uint32_t(testImage.data.size()));
+}
+
+/*
+ * Decodes the test image to RGBA pixels.
+ * Returns the pixels, or an empty array if failed.
+ */
+inline std::vector<uint8_t> decodeTestImage(const TestImage& testImage)
+{
+    PnmImage image;
+    if (openTestImage(testImage, &image))
+        return {};
+    std::vector<uint8_t> pixels(size_t(testImage.widthPx) * testImage.heightPx * 4);
+    if (image.renderToPixelArray(pixels.data(), testImage.widthPx, testImage.heightPx))
+        return {};
+    return pixels;
+}
+
+/*
+ * Compares `pixels` with `expectedPixels`, logging `what` and the name of the image if they differ.
+ *
+ * Returns:
+ *      true, if the pixels are identical.
+ *      false otherwise.
+ */
+inline bool checkPixels(const TestImage& testImage, const char* what,
+        const uint8_t* pixels, size_t size, const std::vector<uint8_t>& expectedPixels)
+{
+    if (pixels && size == expectedPixels.size() && std::memcmp(pixels, expectedPixels.data(), size) == 0)
+        return true;
+    Logger::err << what << ": " << testImage.name << Logger::End;
+    return false;
+}
+
+/*
+ * Logs the result of a test.
+ *
+ * Returns:
+ *      The exit code of the test: 0 if there were no failures, 1 otherwise.
+ */
+inline int reportTestResult(int failureCount, const std::string& successMessage)
+{
+    if (failureCount)
+    {
+        Logger::err << failureCount << " failures" << Logger::End;
+        return 1;
+    }
+    Logger::log << successMessage << Logger::End;
+    return 0;
+}